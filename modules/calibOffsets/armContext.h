@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_ARM_CONTEXT_H__
+#define __CALIB_OFFSETS_ARM_CONTEXT_H__
+
+#include <yarp/sig/Vector.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stampedRing.h"
+#include "skinEvent.h"
+#include "estimators.h"
+#include "offsetField.h"
+
+/********************************************************/
+// Immutable view of the offset of one arm. Snapshots are swapped
+// atomically, so that readers never wait on the skin callback nor on
+// arm motions and always get a consistent tuple.
+struct OffsetSnapshot
+{
+    yarp::sig::Vector offset;
+    yarp::sig::Vector spread;
+    double stamp;
+    int count;
+    bool converged;
+    unsigned long version;
+
+    /********************************************************/
+    OffsetSnapshot() : offset(3, 0.0), spread(3, 0.0), stamp(0.0), count(0), converged(false),
+        version(0)
+    {
+    }
+};
+
+/********************************************************/
+// Calibration state of one arm, so that left and right can be
+// calibrated concurrently and skin events routed by body part.
+struct ArmContext
+{
+    int id;
+    std::string name;
+    int skinId[3];
+    std::vector<yarp::sig::Vector> fieldPositions;
+    yarp::sig::Vector target;
+
+    std::atomic<int> nAxes;
+
+    StampedRing<yarp::sig::Vector> handPositions;
+    StampedRing<double> jointSpeeds;
+
+    // estimator, countOffset, filteredOffset and rawOffsets are guarded
+    // by mtx_estimate, held only while a sample is added or read out
+    std::mutex mtx_estimate;
+    std::unique_ptr<OffsetFilter> estimator;
+    std::atomic<int> countOffset;
+    std::atomic<int> countRejected;
+    yarp::sig::Vector filteredOffset;
+    std::vector<yarp::sig::Vector> rawOffsets;
+    std::shared_ptr<const OffsetSnapshot> snapshot;
+    std::shared_ptr<const OffsetField> field;
+
+    // last stored result and the pose it was measured at, the only
+    // prior a calibration is warm started from, and the prior the
+    // current calibration did start from, if any; guarded by mtx_estimate
+    std::shared_ptr<const OffsetSnapshot> prior;
+    yarp::sig::Vector priorPose;
+    std::shared_ptr<const OffsetSnapshot> startPrior;
+
+    std::atomic<bool> calibrating;
+    std::atomic<bool> calibrated;
+    std::atomic<bool> converged;
+
+    std::mutex mtx_calibrated_part;
+    std::condition_variable part_calibrated;
+
+    /********************************************************/
+    ArmContext(const int id, const std::string &name, const int bodyPart, const int skinPart,
+               const int patch) :
+        id(id), name(name), nAxes(0), countOffset(0),
+        countRejected(0), filteredOffset(3, 0.0), calibrating(false), calibrated(false),
+        converged(false), snapshot(std::make_shared<OffsetSnapshot>())
+    {
+        estimator.reset(new OffsetEstimator);
+        skinId[0] = bodyPart;
+        skinId[1] = skinPart;
+        skinId[2] = patch;
+    }
+
+    /********************************************************/
+    bool owns(const SkinEvent::Contact &contact) const
+    {
+        return (contact.nIds > 3) &&
+               contact.ids[1] == skinId[0] && contact.ids[2] == skinId[1] &&
+               contact.ids[3] == skinId[2];
+    }
+
+    /********************************************************/
+    // Publishes the current estimate; writers hold mtx_estimate
+    void publish(const double stamp, const bool converged)
+    {
+        publish(filteredOffset, estimator->getSpread(), stamp, countOffset, converged);
+    }
+
+    /********************************************************/
+    void publish(const yarp::sig::Vector &offset, const yarp::sig::Vector &spread,
+                 const double stamp, const int count, const bool converged)
+    {
+        std::shared_ptr<OffsetSnapshot> next = std::make_shared<OffsetSnapshot>();
+        next->offset = offset;
+        next->spread = spread;
+        next->stamp = stamp;
+        next->count = count;
+        next->converged = converged;
+        next->version = getSnapshot()->version + 1;
+        std::atomic_store(&snapshot, std::shared_ptr<const OffsetSnapshot>(next));
+    }
+
+    /********************************************************/
+    std::shared_ptr<const OffsetSnapshot> getSnapshot() const
+    {
+        return std::atomic_load(&snapshot);
+    }
+
+    /********************************************************/
+    std::shared_ptr<const OffsetField> getField() const
+    {
+        return std::atomic_load(&field);
+    }
+
+    /********************************************************/
+    void setField(const std::shared_ptr<const OffsetField> &field)
+    {
+        std::atomic_store(&this->field, field);
+    }
+
+    /********************************************************/
+    void stopCalibrating()
+    {
+        calibrating = false;
+        {
+            std::lock_guard<std::mutex> lck(mtx_calibrated_part);
+        }
+        part_calibrated.notify_all();
+    }
+
+    /********************************************************/
+    void notifyCalibrated(const bool converged)
+    {
+        this->converged = converged;
+        calibrating = false;
+        calibrated = true;
+        {
+            std::lock_guard<std::mutex> lck(mtx_calibrated_part);
+        }
+        part_calibrated.notify_all();
+    }
+};
+
+/********************************************************/
+// Calibration started through startCalibration, running on its own thread
+struct CalibrationJob
+{
+    int id;
+    std::string part;
+    int timeout;
+    bool field;
+    std::string state;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> running;
+    std::mutex mtx;
+    std::condition_variable done;
+    std::thread worker;
+
+    /********************************************************/
+    CalibrationJob(const int id, const std::string &part, const int timeout, const bool field) :
+        id(id), part(part), timeout(timeout), field(field), state("moving"), cancelled(false),
+        running(true)
+    {
+    }
+
+    /********************************************************/
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            running = false;
+        }
+        done.notify_all();
+    }
+
+    /********************************************************/
+    // Waits for the job to end and returns its final state
+    std::string wait()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        done.wait(lk, [this]() { return !running; });
+        return state;
+    }
+
+    /********************************************************/
+    void setState(const std::string &state)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        this->state = state;
+    }
+
+    /********************************************************/
+    std::string getState()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return state;
+    }
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include <yarp/os/Network.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/LogStream.h>
+
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "processing.h"
+
+/********************************************************/
+// Synthetic skinManager skin_events:o traffic: every event carries
+// several contacts spread over hands and other body parts, with long
+// active-taxel lists and pressures around the calibration threshold.
+class SkinEventGenerator
+{
+    std::mt19937 gen;
+    int contacts;
+    int taxels;
+    double handRatio;
+    double pressureThresh;
+
+    /********************************************************/
+    void addVector(yarp::os::Bottle &contact)
+    {
+        std::uniform_real_distribution<double> u(-1.0, 1.0);
+        yarp::os::Bottle &v = contact.addList();
+        v.addDouble(u(gen));
+        v.addDouble(u(gen));
+        v.addDouble(u(gen));
+    }
+
+public:
+
+    /********************************************************/
+    SkinEventGenerator(const int contacts, const int taxels, const double handRatio,
+                       const double pressureThresh) :
+        gen(0), contacts(contacts), taxels(taxels), handRatio(handRatio),
+        pressureThresh(pressureThresh)
+    {
+    }
+
+    /********************************************************/
+    void make(yarp::os::Bottle &event)
+    {
+        static const int hands[2][3] = {{3, 6, 1}, {4, 6, 4}};
+        static const int others[4][3] = {{1, 2, 0}, {3, 6, 2}, {4, 6, 5}, {5, 8, 7}};
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        std::uniform_int_distribution<int> taxel(0, 191);
+
+        event.clear();
+        for (int c = 0; c < contacts; c++)
+        {
+            const int *part = (u(gen) < handRatio) ? hands[c % 2] : others[c % 4];
+
+            yarp::os::Bottle &contact = event.addList();
+            yarp::os::Bottle &id = contact.addList();
+            id.addInt(c);
+            id.addInt(part[0]);
+            id.addInt(part[1]);
+            id.addInt(part[2]);
+
+            // centre of pressure, force, moment, geometric centre, normal
+            for (int k = 0; k < 5; k++)
+            {
+                addVector(contact);
+            }
+
+            yarp::os::Bottle &active = contact.addList();
+            for (int i = 0; i < taxels; i++)
+            {
+                active.addInt(taxel(gen));
+            }
+
+            contact.addDouble(2.0 * pressureThresh * u(gen));
+        }
+    }
+};
+
+/********************************************************/
+int main(int argc, char *argv[])
+{
+    yarp::os::Network::init();
+
+    yarp::os::ResourceFinder rf;
+    rf.setDefaultContext("calibOffsets");
+    rf.setDefaultConfigFile("config.ini");
+    rf.setDefault("verbose", yarp::os::Value(false));
+    // the synthetic tracker alternates between the hands
+    rf.setDefault("gateBallJitter", yarp::os::Value(0.0));
+    rf.configure(argc,argv);
+
+    int nEvents = rf.check("events", yarp::os::Value(100000), "number of measured events").asInt();
+    int nWarmup = rf.check("warmup", yarp::os::Value(1000), "number of warm-up events").asInt();
+    int contacts = rf.check("contacts", yarp::os::Value(8), "contacts per event").asInt();
+    int taxels = rf.check("taxels", yarp::os::Value(64), "active taxels per contact").asInt();
+    double handRatio = rf.check("handRatio", yarp::os::Value(0.5), "fraction of contacts on the hands").asDouble();
+    double rate = rf.check("rate", yarp::os::Value(1000.0), "nominal event rate used for the stamps [Hz]").asDouble();
+    double skinPressureThresh = rf.check("skinPressureThresh", yarp::os::Value(20.0)).asDouble();
+
+    Processing *processing = Processing::create(rf);
+    if (processing == NULL)
+    {
+        return 1;
+    }
+    processing->openOffline();
+
+    // a pool of prebuilt events keeps the generator out of the measure;
+    // they are kept in wire format, so that decoding is measured too
+    SkinEventGenerator generator(contacts, taxels, handRatio, skinPressureThresh);
+    std::vector<std::string> pool(256);
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        yarp::os::Bottle event;
+        generator.make(event);
+        size_t size = 0;
+        const char *data = event.toBinary(&size);
+        pool[i].assign(data, size);
+    }
+    SkinEvent event;
+
+    std::mt19937 gen(1);
+    std::normal_distribution<double> noise(0.0, 0.005);
+    yarp::sig::Matrix eye2root(4, 4);
+    eye2root.eye();
+    yarp::sig::Vector xLeft(3, 0.0), xRight(3, 0.0);
+    xLeft[0] = -0.30; xLeft[1] = -0.15; xLeft[2] = 0.10;
+    xRight[0] = -0.30; xRight[1] = 0.15; xRight[2] = 0.10;
+
+    std::vector<double> latency;
+    latency.reserve(nEvents);
+    double busy = 0.0;
+    double t = 0.0;
+    for (int i = 0; i < nWarmup + nEvents; i++)
+    {
+        t += 1.0 / rate;
+        const yarp::sig::Vector &xHand = (i % 2) ? xRight : xLeft;
+        processing->feedTracker(t, xHand[0] + noise(gen), xHand[1] + noise(gen),
+                                xHand[2] + noise(gen), 0.01);
+        processing->feedEyePose(t, eye2root);
+        processing->feedHandPosition(0, t, xLeft);
+        processing->feedHandPosition(1, t, xRight);
+        for (int arm = 0; arm < 2; arm++)
+        {
+            if (!processing->isCalibrating(arm))
+            {
+                processing->startOffline(arm);
+            }
+        }
+
+        const std::string &data = pool[i % pool.size()];
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        event.fromBinary(data.data(), data.size());
+        processing->processSkin(event, t);
+        double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (i >= nWarmup)
+        {
+            latency.push_back(1e6 * dt);
+            busy += dt;
+        }
+    }
+
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&latency](const double p)
+    {
+        return latency.empty() ? 0.0 : latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))];
+    };
+
+    yInfo() << "Events" << nEvents << "contacts/event" << contacts << "taxels/contact" << taxels;
+    yInfo() << "Throughput" << ((busy > 0.0) ? nEvents / busy : 0.0) << "events/s";
+    yInfo() << "Latency [us] p50" << percentile(0.50) << "p90" << percentile(0.90)
+            << "p99" << percentile(0.99) << "p99.9" << percentile(0.999)
+            << "max" << (latency.empty() ? 0.0 : latency.back());
+    yInfo() << "Stats" << processing->getStats().toString();
+
+    delete processing;
+    return 0;
+}
+//empty line to make gcc happy
@@ -9,6 +9,35 @@
 *
 * IDL Interface to \ref Calib Offsets Module.
 */
+struct Bottle {
+} (
+    yarp.name = "yarp::os::Bottle"
+    yarp.includefile = "yarp/os/Bottle.h"
+)
+
+/**
+* CalibrationStatus
+*
+* Progress of a calibration job started with startCalibration.
+*/
+struct CalibrationStatus
+{
+    /** job id. */
+    1: i32 job;
+    /** calibrated part (left / right / both). */
+    2: string part;
+    /** moving / calibrating / converged / completed / timeout / cancelled / failed / unknown. */
+    3: string state;
+    /** number of samples accepted by the estimator. */
+    4: i32 accepted;
+    /** number of skin events rejected by the thresholds. */
+    5: i32 rejected;
+    /** current offset estimate (x, y, z), left then right for both. */
+    6: list<double> estimate;
+    /** spread of the estimate (x, y, z), left then right for both. */
+    7: list<double> spread;
+}
+
 service calibOffsets_IDL
 {
     /**
@@ -18,13 +47,44 @@ service calibOffsets_IDL
     bool quit();
 
     /**
-     * Look at arm and calibrate.
+     * Look at arm and calibrate; fails while another calibration is running.
      * @param part to calibrate.
      * @param timeout in seconds (default 120 s).
      * @return true/false on success/failure
     */
     bool lookAndCalibrate(1:string part, 2:i32 timeout=120);
 
+    /**
+     * Look at both arms and calibrate them concurrently; fails while
+     * another calibration is running.
+     * @param timeout in seconds (default 120 s).
+     * @return true/false on success/failure
+    */
+    bool lookAndCalibrateBoth(1:i32 timeout=120);
+
+    /**
+     * Start calibrating in the background, unless another calibration is
+     * running. The last 16 jobs are kept.
+     * @param part to calibrate (left / right / both).
+     * @param timeout in seconds (default 120 s).
+     * @return job id, -1 if the job could not be started.
+    */
+    i32 startCalibration(1:string part, 2:i32 timeout=120);
+
+    /**
+     * Get the progress of a calibration job.
+     * @param job id returned by startCalibration.
+     * @return status of the job.
+    */
+    CalibrationStatus getStatus(1:i32 job);
+
+    /**
+     * Cancel a running calibration job, stopping the arm and the gaze.
+     * @param job id returned by startCalibration.
+     * @return true/false on success/failure
+    */
+    bool cancel(1:i32 job);
+
     /**
      * Home arms and gaze.
      * @return true/false on success/failure
@@ -39,13 +99,82 @@ service calibOffsets_IDL
     list<double> getOffset(1:string part);
 
     /**
-     * Reset calibration offsets and clear output file.
+     * Get reaching offset at a hand position, interpolated from the
+     * offset field of the part; the offset from getOffset is returned
+     * until calibrateField has been run.
+     * @param part to get the offset.
+     * @param x hand position with respect to robot root [m].
+     * @param y hand position with respect to robot root [m].
+     * @param z hand position with respect to robot root [m].
+     * @return reaching offset (x, y, z) with respect to robot root.
+    */
+    list<double> getOffsetAt(1:string part, 2:double x, 3:double y, 4:double z);
+
+    /**
+     * Calibrate at every position of the field grid of the part
+     * (fieldLeftPositions / fieldRightPositions) and build its offset field;
+     * fails while another calibration is running.
+     * @param part to calibrate (left / right).
+     * @param timeout in seconds for each position (default 120 s).
+     * @return true/false on success/failure
+    */
+    bool calibrateField(1:string part, 2:i32 timeout=120);
+
+    /**
+     * Start recording skin events, tracker samples, poses, arm and head
+     * joint speeds and the start and stop of each arm calibration to a
+     * binary log that can be replayed offline with --replay <file>.
+     * @param file path of the log.
+     * @return true/false on success/failure
+    */
+    bool startRecording(1:string file);
+
+    /**
+     * Stop recording.
+     * @return true/false on success/failure
+    */
+    bool stopRecording();
+
+    /**
+     * Get the skin processing statistics.
+     * @return event counters (received, filtered by pressure, filtered by
+     * taxel count, rejected by likelihood, accepted, ...) and per-stage
+     * latency histograms of the skin processing: decode (port reader),
+     * route, taxels, tracker, poses, gate and estimator per contact, and
+     * event for the whole event after decoding.
+    */
+    Bottle getStats();
+
+    /**
+     * Read skinPressureThresh, activeTaxelsThresh, ballLikelihoodThresh,
+     * filterOrder, xOffset, ballRadius, the taxel regions and the
+     * calibration poses again from the configuration file, without
+     * reopening the devices.
+     * @return true if all the values were valid and are now in use.
+    */
+    bool reloadConfig();
+
+    /**
+     * Reset calibration offsets, cancelling the running calibration.
      * @return true/false on success/failure.
     */
     bool reset();
 
     /**
-     * True if file has been written.
+     * Write the offsets of the calibrated arms into the reach_offset and
+     * grasp_offset keys of the [left_arm] / [right_arm] groups of a
+     * configuration file, e.g. config.ini of demoRedBall, in one atomic write.
+     * The file is written to the home context, imported there if only the
+     * installed copy exists.
+     * @param context where the file is looked up.
+     * @param file name of the configuration file.
+     * @return path of the file written, empty on failure.
+    */
+    string exportTo(1:string context, 2:string file);
+
+    /**
+     * True if file has been written. The file is
+     * calibOffsetsResults_<robot>.txt in the home context.
      * @param part to be saved in the output file (left / right / both).
      * @return true/false on success/failure.
     */
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_CALIB_PARAMS_H__
+#define __CALIB_OFFSETS_CALIB_PARAMS_H__
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Searchable.h>
+#include <yarp/os/Value.h>
+
+#include <yarp/sig/Vector.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/********************************************************/
+// Taxels of a hand skin patch that make a palm contact, built from the
+// named regions of the [taxel_regions] group. Membership is a bitset
+// lookup; regions given with a weight other than 1 make the score of a
+// contact the sum of the weights of its taxels rather than their number.
+class TaxelMask
+{
+public:
+
+    static const int maxTaxels = 1024;
+
+private:
+
+    std::bitset<maxTaxels> taxels;
+    std::vector<double> weights;
+    bool weighted;
+
+    /********************************************************/
+    bool addRegion(const yarp::os::Bottle &ids, const double weight, std::string &error)
+    {
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            int id = ids.get(i).asInt();
+            if ((id < 0) || (id >= maxTaxels))
+            {
+                error = "taxel " + std::to_string(id) + " out of range";
+                return false;
+            }
+            weights[id] = taxels.test(id) ? std::max(weights[id], weight) : weight;
+            taxels.set(id);
+        }
+        weighted = weighted || (weight != 1.0);
+        return true;
+    }
+
+public:
+
+    /********************************************************/
+    TaxelMask() : weights(maxTaxels, 0.0), weighted(false)
+    {
+    }
+
+    /********************************************************/
+    double score(const int *ids, const size_t n) const
+    {
+        double score = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            int id = ids[i];
+            if ((id >= 0) && (id < maxTaxels) && taxels.test(id))
+            {
+                score += weighted ? weights[id] : 1.0;
+            }
+        }
+        return score;
+    }
+
+    /********************************************************/
+    size_t size() const
+    {
+        return taxels.count();
+    }
+
+    /********************************************************/
+    // Reads the regions listed under key, each one a name or a (name
+    // weight) pair; without the key the palm of the standard hand is used
+    bool fromConfig(const yarp::os::Searchable &config, const std::string &key, std::string &error)
+    {
+        taxels.reset();
+        std::fill(weights.begin(), weights.end(), 0.0);
+        weighted = false;
+
+        yarp::os::Bottle *names = config.find(key).asList();
+        if (names == NULL)
+        {
+            yarp::os::Bottle palm("97 99 100 102 103 104 122 126 127 128 129 130");
+            return addRegion(palm, 1.0, error);
+        }
+
+        yarp::os::Bottle &regions = config.findGroup("taxel_regions");
+        for (size_t i = 0; i < names->size(); i++)
+        {
+            std::string name = names->get(i).asString();
+            double weight = 1.0;
+            yarp::os::Bottle *entry = names->get(i).asList();
+            if (entry != NULL)
+            {
+                name = entry->get(0).asString();
+                weight = (entry->size() > 1) ? entry->get(1).asDouble() : 1.0;
+            }
+            yarp::os::Bottle *ids = regions.find(name).asList();
+            if (ids == NULL)
+            {
+                error = key + ": unknown taxel region \"" + name + "\"";
+                return false;
+            }
+            if (!std::isfinite(weight) || (weight < 0.0))
+            {
+                error = key + ": weight of " + name + " must be non-negative";
+                return false;
+            }
+            if (!addRegion(*ids, weight, error))
+            {
+                error = key + ": " + name + " has " + error;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/********************************************************/
+// Thresholds and poses that can be tuned on a running module: they are
+// read through a snapshot that reloadConfig swaps as a whole, so every
+// skin event is processed with one consistent set of values.
+struct CalibParams
+{
+    double skinPressureThresh;
+    int activeTaxelsThresh;
+    double ballLikelihoodThresh;
+    int filterOrder;
+    double xOffset;
+    double ballRadius;
+    yarp::sig::Vector calibPose[2];
+    yarp::sig::Vector calibPos[2];
+    TaxelMask taxelMask[2];
+
+    /********************************************************/
+    CalibParams() : skinPressureThresh(20.0), activeTaxelsThresh(3),
+        ballLikelihoodThresh(0.0005), filterOrder(20), xOffset(0.01), ballRadius(0.03)
+    {
+    }
+
+    /********************************************************/
+    static bool toVector(const yarp::os::Searchable &config, const std::string &key,
+                         const size_t n, yarp::sig::Vector &x)
+    {
+        yarp::os::Bottle *b = config.find(key).asList();
+        if ((b == NULL) || (b->size() < n))
+        {
+            return false;
+        }
+        x.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            x[i] = b->get(i).asDouble();
+        }
+        return true;
+    }
+
+    /********************************************************/
+    // Reads and validates the values, error tells the first one rejected
+    bool fromConfig(const yarp::os::Searchable &config, std::string &error)
+    {
+        skinPressureThresh = config.check("skinPressureThresh", yarp::os::Value(20.0), "threshold for skin average pressure").asDouble();
+        activeTaxelsThresh = config.check("activeTaxelsThresh", yarp::os::Value(3), "threshold for palm active taxels").asInt();
+        ballLikelihoodThresh = config.check("ballLikelihoodThresh", yarp::os::Value(0.0005), "threshold on likelihood for detecting the ball").asDouble();
+        filterOrder = config.check("filterOrder", yarp::os::Value(20), "maximum number of samples per calibration").asInt();
+        xOffset = config.check("xOffset", yarp::os::Value(0.01), "offset to apply on the x direction [m]").asDouble();
+        ballRadius = config.check("ballRadius", yarp::os::Value(0.03), "ball radius [m]").asDouble();
+
+        if (!toVector(config, "calibLeft", 7, calibPose[0]) || !toVector(config, "calibRight", 7, calibPose[1]))
+        {
+            error = "Could not find calibLeft or calibRight";
+            return false;
+        }
+        if (!toVector(config, "calibLeftPosition", 9, calibPos[0]) ||
+            !toVector(config, "calibRightPosition", 9, calibPos[1]))
+        {
+            error = "Could not find calibLeftPosition or calibRightPosition";
+            return false;
+        }
+        if (!taxelMask[0].fromConfig(config, "leftTaxelRegions", error) ||
+            !taxelMask[1].fromConfig(config, "rightTaxelRegions", error))
+        {
+            return false;
+        }
+        if (!std::isfinite(skinPressureThresh) || (skinPressureThresh < 0.0))
+        {
+            error = "skinPressureThresh must be non-negative";
+            return false;
+        }
+        if (activeTaxelsThresh < 0)
+        {
+            error = "activeTaxelsThresh must be non-negative";
+            return false;
+        }
+        if (!std::isfinite(ballLikelihoodThresh) || (ballLikelihoodThresh < 0.0))
+        {
+            error = "ballLikelihoodThresh must be non-negative";
+            return false;
+        }
+        if (filterOrder < 1)
+        {
+            error = "filterOrder must be positive";
+            return false;
+        }
+        if (!std::isfinite(xOffset) || !std::isfinite(ballRadius) || (ballRadius <= 0.0))
+        {
+            error = "xOffset must be finite and ballRadius positive";
+            return false;
+        }
+        for (int arm = 0; arm < 2; arm++)
+        {
+            for (size_t i = 0; i < calibPose[arm].length(); i++)
+            {
+                if (!std::isfinite(calibPose[arm][i]))
+                {
+                    error = "calibLeft / calibRight contain invalid values";
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < calibPos[arm].length(); i++)
+            {
+                if (!std::isfinite(calibPos[arm][i]))
+                {
+                    error = "calibLeftPosition / calibRightPosition contain invalid values";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+#endif
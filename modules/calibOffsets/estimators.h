@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_ESTIMATORS_H__
+#define __CALIB_OFFSETS_ESTIMATORS_H__
+
+#include <yarp/sig/Vector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/********************************************************/
+// Estimate of a constant 3-D offset from noisy samples.
+class OffsetFilter
+{
+public:
+
+    /********************************************************/
+    virtual ~OffsetFilter()
+    {
+    }
+
+    virtual void init(const size_t expectedSamples) = 0;
+    // returns false if the sample has been discarded
+    virtual bool add(const yarp::sig::Vector &sample) = 0;
+    virtual size_t getCount() const = 0;
+    virtual const yarp::sig::Vector &getEstimate() const = 0;
+    virtual const yarp::sig::Vector &getSpread() const = 0;
+
+    /********************************************************/
+    // Result of a previous calibration, ignored by default
+    virtual void setPrior(const yarp::sig::Vector &offset, const yarp::sig::Vector &spread)
+    {
+    }
+
+    /********************************************************/
+    virtual bool converged(const size_t minSamples, const double tolerance) const
+    {
+        if (getCount() < minSamples)
+        {
+            return false;
+        }
+        const yarp::sig::Vector &spread = getSpread();
+        for (size_t a = 0; a < spread.length(); a++)
+        {
+            if (spread[a] > tolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/********************************************************/
+// Running median and median absolute deviation of 3-D offset samples.
+// Each axis keeps its samples in a sorted array, so a sample costs a
+// binary search plus an O(n) shift of the larger ones, n being capped by
+// filterOrder; the median is then read in O(1) and the MAD is selected
+// in O(log n) from the two sorted runs of deviations on either side of it.
+class OffsetEstimator : public OffsetFilter
+{
+    std::vector<std::vector<double> > sorted;
+    yarp::sig::Vector estimate;
+    yarp::sig::Vector spread;
+
+    /********************************************************/
+    // k-th smallest (0-based) of |v[i] - med| for a sorted v, with p the
+    // index of the first element not lower than med
+    static double kthDeviation(const std::vector<double> &v, const double med,
+                               const size_t p, const size_t k)
+    {
+        const size_t na = p;
+        const size_t nb = v.size() - p;
+        auto A = [&](size_t i) { return med - v[p - 1 - i]; };
+        auto B = [&](size_t i) { return v[p + i] - med; };
+
+        size_t lo = (k + 1 > nb) ? k + 1 - nb : 0;
+        size_t hi = std::min(k + 1, na);
+        while (lo < hi)
+        {
+            size_t i = (lo + hi) / 2;
+            if (A(i) < B(k - i))
+            {
+                lo = i + 1;
+            }
+            else
+            {
+                hi = i;
+            }
+        }
+
+        size_t j = k + 1 - lo;
+        double d = -1.0;
+        if (lo > 0)
+        {
+            d = A(lo - 1);
+        }
+        if (j > 0)
+        {
+            d = std::max(d, B(j - 1));
+        }
+        return d;
+    }
+
+public:
+
+    /********************************************************/
+    OffsetEstimator() : sorted(3), estimate(3, 0.0), spread(3, 0.0)
+    {
+    }
+
+    /********************************************************/
+    void init(const size_t expectedSamples) override
+    {
+        for (auto &axis : sorted)
+        {
+            axis.clear();
+            axis.reserve(expectedSamples);
+        }
+        estimate = 0.0;
+        spread = 0.0;
+    }
+
+    /********************************************************/
+    bool add(const yarp::sig::Vector &sample) override
+    {
+        for (size_t a = 0; a < sorted.size(); a++)
+        {
+            std::vector<double> &v = sorted[a];
+            v.insert(std::upper_bound(v.begin(), v.end(), sample[a]), sample[a]);
+
+            const size_t n = v.size();
+            double med = (n % 2) ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+            size_t p = std::lower_bound(v.begin(), v.end(), med) - v.begin();
+            double mad = (n % 2) ? kthDeviation(v, med, p, n/2) :
+                                   0.5 * (kthDeviation(v, med, p, n/2 - 1) + kthDeviation(v, med, p, n/2));
+
+            // standard error of the median, with the MAD scaled to a
+            // standard deviation under gaussian noise
+            estimate[a] = med;
+            spread[a] = 1.2533 * 1.4826 * mad / std::sqrt((double)n);
+        }
+        return true;
+    }
+
+    /********************************************************/
+    size_t getCount() const override
+    {
+        return sorted[0].size();
+    }
+
+    /********************************************************/
+    const yarp::sig::Vector &getEstimate() const override
+    {
+        return estimate;
+    }
+
+    /********************************************************/
+    const yarp::sig::Vector &getSpread() const override
+    {
+        return spread;
+    }
+};
+
+/********************************************************/
+// Recursive estimate of a constant offset: a scalar Kalman filter per
+// axis, warm-started from the previous calibration when there is one,
+// whose variance is inflated by the drift expected in between; a cold
+// filter is initialised by its first sample. Later samples whose
+// normalized innovation exceeds the validation gate are discarded; a
+// run of maxOutliers of them means the prior no longer holds, and the
+// filter restarts from the last sample. The spread is the posterior
+// deviation scaled by the mean normalized innovation, when above one,
+// so that samples more scattered than the noise model delay convergence.
+class KalmanOffsetEstimator : public OffsetFilter
+{
+    double R;
+    double P0;
+    double drift;
+    double gate;
+    size_t minSamplesPrior;
+    int maxOutliers;
+
+    yarp::sig::Vector x;
+    yarp::sig::Vector P;
+    yarp::sig::Vector nis;
+    yarp::sig::Vector spread;
+    size_t count;
+    size_t updates;
+    int outliers;
+    bool warm;
+
+    /********************************************************/
+    void restart(const yarp::sig::Vector &x0, const double var)
+    {
+        x = x0;
+        P = var;
+        nis = 0.0;
+        updates = 0;
+        for (size_t a = 0; a < spread.length(); a++)
+        {
+            spread[a] = std::sqrt(P[a]);
+        }
+        outliers = 0;
+    }
+
+public:
+
+    /********************************************************/
+    KalmanOffsetEstimator(const double noise, const double initialStd, const double drift,
+                          const double gate, const size_t minSamplesPrior, const int maxOutliers) :
+        R(noise * noise), P0(initialStd * initialStd), drift(drift), gate(gate),
+        minSamplesPrior(minSamplesPrior), maxOutliers(maxOutliers), x(3, 0.0), P(3, P0),
+        nis(3, 0.0), spread(3, initialStd), count(0), updates(0), outliers(0), warm(false)
+    {
+    }
+
+    /********************************************************/
+    void init(const size_t expectedSamples) override
+    {
+        restart(yarp::sig::Vector(3, 0.0), P0);
+        count = 0;
+        warm = false;
+    }
+
+    /********************************************************/
+    void setPrior(const yarp::sig::Vector &offset, const yarp::sig::Vector &spread) override
+    {
+        restart(offset, 0.0);
+        for (size_t a = 0; a < P.length(); a++)
+        {
+            P[a] = spread[a] * spread[a] + drift * drift;
+            this->spread[a] = std::sqrt(P[a]);
+        }
+        warm = true;
+    }
+
+    /********************************************************/
+    bool add(const yarp::sig::Vector &sample) override
+    {
+        // without a prior there is nothing to gate the first sample
+        // against, it sets the state
+        if (!warm && (count == 0))
+        {
+            restart(sample, R);
+            count = 1;
+            return true;
+        }
+
+        double d2 = 0.0;
+        for (size_t a = 0; a < x.length(); a++)
+        {
+            double y = sample[a] - x[a];
+            d2 += y * y / (P[a] + R);
+        }
+
+        if (d2 > gate)
+        {
+            if (++outliers < maxOutliers)
+            {
+                return false;
+            }
+            restart(sample, R);
+            count = 1;
+            warm = false;
+            return true;
+        }
+
+        updates++;
+        for (size_t a = 0; a < x.length(); a++)
+        {
+            double y = sample[a] - x[a];
+            nis[a] += y * y / (P[a] + R);
+            double K = P[a] / (P[a] + R);
+            x[a] += K * y;
+            P[a] *= (1.0 - K);
+            spread[a] = std::sqrt(P[a] * std::max(1.0, nis[a] / updates));
+        }
+        outliers = 0;
+        count++;
+        return true;
+    }
+
+    /********************************************************/
+    size_t getCount() const override
+    {
+        return count;
+    }
+
+    /********************************************************/
+    const yarp::sig::Vector &getEstimate() const override
+    {
+        return x;
+    }
+
+    /********************************************************/
+    const yarp::sig::Vector &getSpread() const override
+    {
+        return spread;
+    }
+
+    /********************************************************/
+    // a good prior needs only a handful of confirming samples
+    bool converged(const size_t minSamples, const double tolerance) const override
+    {
+        return OffsetFilter::converged(warm ? std::min(minSamples, minSamplesPrior) : minSamples,
+                                       tolerance);
+    }
+};
+
+#endif
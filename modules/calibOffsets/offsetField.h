@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_OFFSET_FIELD_H__
+#define __CALIB_OFFSETS_OFFSET_FIELD_H__
+
+#include <yarp/os/LogStream.h>
+
+#include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
+#include <yarp/math/Math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/********************************************************/
+// Offset over the workspace, from the robust offsets measured at a few
+// hand positions: Gaussian RBF interpolation of their deviation from the
+// mean offset, sampled once on a regular grid so that a lookup is a
+// trilinear blend of the eight surrounding nodes.
+class OffsetField
+{
+    std::vector<yarp::sig::Vector> positions;
+    std::vector<yarp::sig::Vector> offsets;
+
+    double lo[3];
+    int n[3];
+    double step[3];
+    std::vector<double> grid;
+
+    /********************************************************/
+    size_t node(const int i, const int j, const int k) const
+    {
+        return 3 * (((size_t)i * n[1] + j) * n[2] + k);
+    }
+
+public:
+
+    /********************************************************/
+    OffsetField()
+    {
+        clear();
+    }
+
+    /********************************************************/
+    void clear()
+    {
+        positions.clear();
+        offsets.clear();
+        grid.clear();
+        for (int d = 0; d < 3; d++)
+        {
+            lo[d] = 0.0;
+            n[d] = 0;
+            step[d] = 0.0;
+        }
+    }
+
+    /********************************************************/
+    void add(const yarp::sig::Vector &x, const yarp::sig::Vector &offset)
+    {
+        positions.push_back(x.subVector(0, 2));
+        offsets.push_back(offset.subVector(0, 2));
+    }
+
+    /********************************************************/
+    size_t size() const
+    {
+        return positions.size();
+    }
+
+    /********************************************************/
+    bool isValid() const
+    {
+        return !grid.empty();
+    }
+
+    /********************************************************/
+    // Fits the RBF weights and fills a grid covering the measured
+    // positions plus margin, with at most maxNodes nodes per axis
+    bool build(const double width, const double resolution, const double margin,
+               const int maxNodes = 64)
+    {
+        size_t N = positions.size();
+        if ((N == 0) || (width <= 0.0) || (resolution <= 0.0))
+        {
+            return false;
+        }
+
+        yarp::sig::Vector mean(3, 0.0);
+        for (size_t i = 0; i < N; i++)
+        {
+            mean = mean + offsets[i] / (double)N;
+        }
+
+        auto kernel = [width](const yarp::sig::Vector &a, const yarp::sig::Vector &b)
+        {
+            yarp::sig::Vector d = a - b;
+            return std::exp(-yarp::math::dot(d, d) / (2.0 * width * width));
+        };
+
+        yarp::sig::Matrix Phi(N, N);
+        for (size_t i = 0; i < N; i++)
+        {
+            for (size_t j = 0; j < N; j++)
+            {
+                Phi(i, j) = kernel(positions[i], positions[j]);
+            }
+        }
+        // coincident positions make Phi singular, pinv averages them
+        yarp::sig::Matrix PhiInv = yarp::math::pinv(Phi, 1e-9);
+
+        yarp::sig::Matrix W(N, 3);
+        for (int d = 0; d < 3; d++)
+        {
+            yarp::sig::Vector y(N);
+            for (size_t i = 0; i < N; i++)
+            {
+                y[i] = offsets[i][d] - mean[d];
+            }
+            W.setSubcol(PhiInv * y, 0, d);
+        }
+
+        for (int d = 0; d < 3; d++)
+        {
+            double mn = positions[0][d], mx = positions[0][d];
+            for (size_t i = 1; i < N; i++)
+            {
+                mn = std::min(mn, positions[i][d]);
+                mx = std::max(mx, positions[i][d]);
+            }
+            // a capped axis keeps covering the whole extent with a
+            // coarser spacing
+            double extent = mx - mn + 2.0 * margin;
+            lo[d] = mn - margin;
+            n[d] = std::min(maxNodes, (int)std::ceil(extent / resolution) + 1);
+            n[d] = std::max(n[d], 2);
+            step[d] = resolution;
+            if ((n[d] - 1) * resolution < extent)
+            {
+                step[d] = extent / (n[d] - 1);
+                yWarning() << "Offset field capped at" << maxNodes << "nodes, spacing"
+                           << step[d] << "m instead of" << resolution << "m";
+            }
+        }
+
+        grid.assign(3 * (size_t)n[0] * n[1] * n[2], 0.0);
+        yarp::sig::Vector x(3);
+        for (int i = 0; i < n[0]; i++)
+        {
+            for (int j = 0; j < n[1]; j++)
+            {
+                for (int k = 0; k < n[2]; k++)
+                {
+                    x[0] = lo[0] + i * step[0];
+                    x[1] = lo[1] + j * step[1];
+                    x[2] = lo[2] + k * step[2];
+                    double *g = &grid[node(i, j, k)];
+                    for (int d = 0; d < 3; d++)
+                    {
+                        g[d] = mean[d];
+                    }
+                    for (size_t c = 0; c < N; c++)
+                    {
+                        double phi = kernel(x, positions[c]);
+                        for (int d = 0; d < 3; d++)
+                        {
+                            g[d] += W(c, d) * phi;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /********************************************************/
+    // Offset at (x, y, z); positions outside the grid take the value at
+    // the closest point of its boundary
+    bool lookup(const double x, const double y, const double z, yarp::sig::Vector &offset) const
+    {
+        if (grid.empty())
+        {
+            return false;
+        }
+
+        const double p[3] = {x, y, z};
+        int c[3];
+        double w[3];
+        for (int d = 0; d < 3; d++)
+        {
+            double u = std::min(std::max((p[d] - lo[d]) / step[d], 0.0), (double)(n[d] - 1));
+            c[d] = std::min((int)u, n[d] - 2);
+            w[d] = u - c[d];
+        }
+
+        offset.resize(3);
+        offset.zero();
+        for (int corner = 0; corner < 8; corner++)
+        {
+            int di = corner & 1, dj = (corner >> 1) & 1, dk = (corner >> 2) & 1;
+            double weight = (di ? w[0] : 1.0 - w[0]) * (dj ? w[1] : 1.0 - w[1]) *
+                            (dk ? w[2] : 1.0 - w[2]);
+            const double *g = &grid[node(c[0] + di, c[1] + dj, c[2] + dk)];
+            for (int d = 0; d < 3; d++)
+            {
+                offset[d] += weight * g[d];
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_POSE_CACHE_H__
+#define __CALIB_OFFSETS_POSE_CACHE_H__
+
+#include <yarp/os/PeriodicThread.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+
+#include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
+#include <yarp/math/Math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "robot.h"
+#include "stampedRing.h"
+#include "sessionRecorder.h"
+#include "armContext.h"
+
+/********************************************************/
+// Samples the eye and hand poses in the background, so that skin events
+// are matched against the poses at their own timestamp and the skin
+// callback never waits on a controller round-trip.
+class PoseCache : public yarp::os::PeriodicThread
+{
+    RobotInterface *robot;
+    std::vector<ArmContext*> arms;
+    StampedRing<yarp::sig::Matrix> eyePoses;
+    StampedRing<double> headSpeeds;
+    std::vector<double> q, dq;
+    SessionRecorder *recorder;
+
+    /********************************************************/
+    static double stampTime(const yarp::os::Stamp &stamp)
+    {
+        return stamp.isValid() ? stamp.getTime() : yarp::os::Time::now();
+    }
+
+    /********************************************************/
+    void run() override
+    {
+        // every sample is stamped with the envelope of the stream it comes
+        // from, the clock of the skin and tracker stamps
+        yarp::sig::Vector x, o;
+        yarp::os::Stamp stamp;
+        if (robot->getEyePose(x, o, &stamp))
+        {
+            yarp::sig::Matrix eye2root = yarp::math::axis2dcm(o);
+            eye2root.setSubcol(x, 0, 3);
+            pushEye(stampTime(stamp), eye2root);
+        }
+
+        // the gaze motion is read from the head joint speeds, and only
+        // kept with a valid stamp of their own: on the local clock they
+        // could not be matched against the skin stamps
+        double speed;
+        if (robot->getHeadSpeed(speed, &stamp) && stamp.isValid())
+        {
+            pushHeadSpeed(stamp.getTime(), speed);
+        }
+
+        for (size_t i = 0; i < arms.size(); i++)
+        {
+            if (robot->getHandPose(arms[i]->id, x, o, &stamp))
+            {
+                pushHand(*arms[i], stampTime(stamp), x);
+            }
+
+            // fastest joint, for the motion gate of the skin samples
+            int nAxes = arms[i]->nAxes;
+            q.resize(std::max(nAxes, 1));
+            dq.resize(std::max(nAxes, 1));
+            if ((nAxes > 0) && robot->getEncoders(arms[i]->id, q.data(), dq.data(), &stamp) &&
+                stamp.isValid())
+            {
+                speed = 0.0;
+                for (int j = 0; j < nAxes; j++)
+                {
+                    speed = std::max(speed, std::fabs(dq[j]));
+                }
+                pushJointSpeed(*arms[i], stamp.getTime(), speed);
+            }
+        }
+    }
+
+public:
+
+    /********************************************************/
+    PoseCache(const double period) : yarp::os::PeriodicThread(period), robot(NULL), recorder(NULL)
+    {
+    }
+
+    /********************************************************/
+    void configure(RobotInterface *robot, const std::vector<ArmContext*> &arms,
+                   const int bufferSize, SessionRecorder *recorder)
+    {
+        this->robot = robot;
+        this->arms = arms;
+        this->recorder = recorder;
+        eyePoses.resize(bufferSize);
+        headSpeeds.resize(bufferSize);
+        for (size_t i = 0; i < arms.size(); i++)
+        {
+            arms[i]->handPositions.resize(bufferSize);
+            arms[i]->jointSpeeds.resize(bufferSize);
+        }
+    }
+
+    /********************************************************/
+    void pushEye(const double t, const yarp::sig::Matrix &eye2root)
+    {
+        eyePoses.push(t, eye2root);
+        if ((recorder != NULL) && recorder->isActive())
+        {
+            recorder->recordEye(t, eye2root);
+        }
+    }
+
+    /********************************************************/
+    void pushHand(ArmContext &arm, const double t, const yarp::sig::Vector &x)
+    {
+        arm.handPositions.push(t, x);
+        if ((recorder != NULL) && recorder->isActive())
+        {
+            recorder->recordHand(t, arm.id, x);
+        }
+    }
+
+    /********************************************************/
+    void pushJointSpeed(ArmContext &arm, const double t, const double speed)
+    {
+        arm.jointSpeeds.push(t, speed);
+        if ((recorder != NULL) && recorder->isActive())
+        {
+            recorder->recordJointSpeed(t, arm.id, speed);
+        }
+    }
+
+    /********************************************************/
+    void pushHeadSpeed(const double t, const double speed)
+    {
+        headSpeeds.push(t, speed);
+        if ((recorder != NULL) && recorder->isActive())
+        {
+            recorder->recordHeadSpeed(t, speed);
+        }
+    }
+
+    /********************************************************/
+    bool getEyePose(const double t, const double maxSkew, yarp::sig::Matrix &eye2root)
+    {
+        return eyePoses.nearest(t, maxSkew, eye2root);
+    }
+
+    /********************************************************/
+    bool getHeadSpeed(const double t, const double maxSkew, double &speed)
+    {
+        return headSpeeds.nearest(t, maxSkew, speed);
+    }
+};
+
+#endif
@@ -0,0 +1,2312 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_PROCESSING_H__
+#define __CALIB_OFFSETS_PROCESSING_H__
+
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/PeriodicThread.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Os.h>
+
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/dev/CartesianControl.h>
+#include <yarp/dev/GazeControl.h>
+#include <yarp/dev/IControlMode.h>
+#include <yarp/dev/IPositionControl.h>
+#include <yarp/dev/IEncoders.h>
+
+#include <yarp/math/Math.h>
+#include <sstream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <map>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <sys/stat.h>
+
+#include "calibOffsets_IDL.h"
+#include "robot.h"
+#include "skinEvent.h"
+#include "sessionRecorder.h"
+#include "trackerReader.h"
+#include "estimators.h"
+#include "offsetField.h"
+#include "stats.h"
+#include "resultStore.h"
+#include "calibParams.h"
+#include "armContext.h"
+#include "poseCache.h"
+#include "workerPool.h"
+
+/********************************************************/
+class Processing : public yarp::os::BufferedPort<SkinEvent>
+{   
+
+    std::string moduleName;
+    std::string robotName;
+    yarp::sig::Vector homePos, homeVels;
+    std::shared_ptr<const CalibParams> params;
+    std::string configFile;
+    std::string configGroup;
+    yarp::os::Property overrides;
+    // mtimes of the file last applied and last rejected, for the watch
+    std::atomic<time_t> configTime;
+    std::atomic<time_t> rejectedTime;
+    int minSamples;
+    double convergenceTol;
+    double trackerMaxSkew;
+    int trackerBufferSize;
+    double poseMaxSkew;
+    int poseBufferSize;
+    std::string bimanualGaze;
+    double gazeSwitchPeriod;
+    double motionTol;
+    double motionVelTol;
+    double motionStallTime;
+    double gazeRefineTol;
+    double fieldKernelWidth;
+    double fieldResolution;
+    double fieldMargin;
+    double gateJointSpeed;
+    double gateGazeSpeed;
+    double gateBallJitter;
+    double gateWindow;
+    std::string skinPolicy;
+    double skinMaxAge;
+    int lastSkinCount;
+    std::string skinSource;
+    std::atomic<bool> skinConnected;
+    std::shared_ptr<std::atomic<bool> > skinIdle;
+    bool verbose;
+    yarp::os::ResourceFinder rf;
+
+    TrackerReader trackerInPort;
+    yarp::os::BufferedPort<yarp::os::Bottle> offsetsOutPort;
+    PoseCache poseCache;
+    SessionRecorder recorder;
+    ResultStore store;
+    std::string storeDir;
+
+    ArmContext leftArm, rightArm;
+
+    RobotInterface *robot;
+
+    WorkerPool *pool;
+    std::deque<std::pair<yarp::os::Stamp, SkinEvent> > skinQueue;
+    std::mutex mtx_queue;
+    std::condition_variable queueDrained;
+    bool drainScheduled;
+
+    // serializes the motion commands of the rpc and job threads; skin
+    // processing never takes it
+    std::mutex mtx_devices;
+    std::mutex mtx_open;
+    std::mutex mtx_subscription;
+    std::mutex mtx_idle;
+
+    // every calibration, synchronous rpc or not, runs as a job and only
+    // one at a time; activeJob is the running or last one, whose cancel
+    // flag the motions check
+    std::map<int, std::shared_ptr<CalibrationJob> > jobs;
+    std::shared_ptr<CalibrationJob> activeJob;
+    std::mutex mtx_jobs;
+    int nextJob;
+    std::atomic<bool> closing;
+    static const size_t maxJobs = 16;
+
+    CalibStats stats;
+
+    std::string oLeft, oRight;
+
+public:
+
+
+    /********************************************************/
+    // Settings are read from config, files are looked up through rf;
+    // params is the validated calibration part of config, the robot is
+    // owned from now on
+    Processing( const CalibParams &params, const yarp::os::Searchable &config,
+                RobotInterface *robot, yarp::os::ResourceFinder &rf) :
+                poseCache(config.check("posePeriod", yarp::os::Value(0.01), "period of the eye / hand pose sampling [s]").asDouble()),
+                leftArm(0, "left", 3, 6, 1), rightArm(1, "right", 4, 6, 4),
+                pool(NULL), drainScheduled(false)
+    {
+        this->rf=rf;
+        this->lastSkinCount = -1;
+        this->skinConnected = false;
+        this->skinIdle = std::make_shared<std::atomic<bool> >(true);
+        this->robot = robot;
+        moduleName = config.check("name", yarp::os::Value("calibOffsets"), "module name (string)").asString();
+        robotName = config.check("robot", yarp::os::Value("icub"), "robot name (string)").asString();
+        configGroup = config.check("configGroup", yarp::os::Value(""), "group of the configuration file overriding the common settings").asString();
+
+        this->params = std::make_shared<const CalibParams>(params);
+        configFile = rf.findFile("from");
+        configTime = modificationTime(configFile);
+        rejectedTime = 0;
+
+        yarp::os::Bottle *homep=config.find("homePos").asList();
+        yarp::os::Bottle *homev=config.find("homeVels").asList();
+        if ((homep != NULL) && (homep->size() > 0))
+        {
+            homePos.resize(9);
+            homePos[0] = homep->get(0).asDouble();
+            homePos[1] = homep->get(1).asDouble();
+            homePos[2] = homep->get(2).asDouble();
+            homePos[3] = homep->get(3).asDouble();
+            homePos[4] = homep->get(4).asDouble();
+            homePos[5] = homep->get(5).asDouble();
+            homePos[6] = homep->get(6).asDouble();
+            homePos[7] = homep->get(7).asDouble();
+            homePos[8] = homep->get(8).asDouble();
+        }
+
+        if ((homev != NULL) && (homev->size() > 0))
+        {
+            homeVels.resize(9);
+            homeVels[0] = homev->get(0).asDouble();
+            homeVels[1] = homev->get(1).asDouble();
+            homeVels[2] = homev->get(2).asDouble();
+            homeVels[3] = homev->get(3).asDouble();
+            homeVels[4] = homev->get(4).asDouble();
+            homeVels[5] = homev->get(5).asDouble();
+            homeVels[6] = homev->get(6).asDouble();
+            homeVels[7] = homev->get(7).asDouble();
+            homeVels[8] = homev->get(8).asDouble();
+        }
+
+        trackerMaxSkew = config.check("trackerMaxSkew", yarp::os::Value(0.05), "maximum time difference between a skin event and the tracker sample used [s]").asDouble();
+        trackerBufferSize = config.check("trackerBufferSize", yarp::os::Value(32), "number of tracker samples kept for matching skin events").asInt();
+        minSamples = config.check("minSamples", yarp::os::Value(5), "minimum number of samples before checking convergence").asInt();
+        convergenceTol = config.check("convergenceTol", yarp::os::Value(0.002), "spread of the offset estimate below which calibration stops [m]").asDouble();
+        bimanualGaze = config.check("bimanualGaze", yarp::os::Value("midpoint"), "gaze strategy when calibrating both arms (midpoint / alternate)").asString();
+        gazeSwitchPeriod = config.check("gazeSwitchPeriod", yarp::os::Value(2.0), "time spent on each hand in alternate mode [s]").asDouble();
+        poseMaxSkew = config.check("poseMaxSkew", yarp::os::Value(0.05), "maximum time difference between a skin event and the poses used [s]").asDouble();
+        poseBufferSize = config.check("poseBufferSize", yarp::os::Value(32), "number of eye / hand poses kept for matching skin events").asInt();
+        motionTol = config.check("motionTol", yarp::os::Value(2.0), "joint distance from the target for the arm to be in position [deg]").asDouble();
+        motionVelTol = config.check("motionVelTol", yarp::os::Value(1.0), "joint speed below which the arm is still [deg/s]").asDouble();
+        motionStallTime = config.check("motionStallTime", yarp::os::Value(0.5), "time the arm can be still away from the target before giving up [s]").asDouble();
+        gazeRefineTol = config.check("gazeRefineTol", yarp::os::Value(0.02), "hand distance from the predicted position that triggers a new fixation [m]").asDouble();
+        verbose = config.check("verbose", yarp::os::Value(true), "log every skin contact and sample").asBool();
+        fieldKernelWidth = config.check("fieldKernelWidth", yarp::os::Value(0.1), "width of the RBF interpolating the offset field [m]").asDouble();
+        fieldResolution = config.check("fieldResolution", yarp::os::Value(0.01), "spacing of the offset field lookup grid [m]").asDouble();
+        fieldMargin = config.check("fieldMargin", yarp::os::Value(0.05), "extent of the lookup grid beyond the calibrated positions [m]").asDouble();
+        storeDir = config.check("storeDir", yarp::os::Value(rf.getHomeContextPath() + "/results"), "directory of the calibration results history").asString();
+        gateJointSpeed = config.check("gateJointSpeed", yarp::os::Value(5.0), "arm joint speed above which skin samples are discarded, 0 to disable [deg/s]").asDouble();
+        gateGazeSpeed = config.check("gateGazeSpeed", yarp::os::Value(5.0), "head joint speed above which skin samples are discarded, 0 to disable [deg/s]").asDouble();
+        gateBallJitter = config.check("gateBallJitter", yarp::os::Value(0.01), "RMS ball displacement above which skin samples are discarded, 0 to disable [m]").asDouble();
+        gateWindow = config.check("gateWindow", yarp::os::Value(0.1), "time before a skin event over which the ball jitter is measured [s]").asDouble();
+
+        yarp::os::Bottle *fieldLeftPositions=config.find("fieldLeftPositions").asList();
+        yarp::os::Bottle *fieldRightPositions=config.find("fieldRightPositions").asList();
+        for (size_t i = 0; (fieldLeftPositions != NULL) && (i < fieldLeftPositions->size()); i++)
+        {
+            yarp::os::Bottle *q = fieldLeftPositions->get(i).asList();
+            if ((q != NULL) && (q->size() >= params.calibPos[leftArm.id].length()))
+            {
+                yarp::sig::Vector pos(params.calibPos[leftArm.id].length());
+                for (size_t j = 0; j < pos.length(); j++)
+                {
+                    pos[j] = q->get(j).asDouble();
+                }
+                leftArm.fieldPositions.push_back(pos);
+            }
+        }
+
+        for (size_t i = 0; (fieldRightPositions != NULL) && (i < fieldRightPositions->size()); i++)
+        {
+            yarp::os::Bottle *q = fieldRightPositions->get(i).asList();
+            if ((q != NULL) && (q->size() >= params.calibPos[rightArm.id].length()))
+            {
+                yarp::sig::Vector pos(params.calibPos[rightArm.id].length());
+                for (size_t j = 0; j < pos.length(); j++)
+                {
+                    pos[j] = q->get(j).asDouble();
+                }
+                rightArm.fieldPositions.push_back(pos);
+            }
+        }
+
+        std::string estimatorType = config.check("estimator", yarp::os::Value("median"), "offset estimator (median / kalman)").asString();
+        double measurementNoise = config.check("measurementNoise", yarp::os::Value(0.005), "standard deviation of a single offset sample [m]").asDouble();
+        double initialStd = config.check("initialStd", yarp::os::Value(0.1), "standard deviation of the offset without a previous result [m]").asDouble();
+        double priorDrift = config.check("priorDrift", yarp::os::Value(0.003), "drift of the offset expected since the previous result [m]").asDouble();
+        double outlierGate = config.check("outlierGate", yarp::os::Value(11.34), "threshold on the normalized squared innovation of a sample").asDouble();
+        int minSamplesPrior = config.check("minSamplesPrior", yarp::os::Value(2), "minimum number of samples when starting from a previous result").asInt();
+        int maxOutliers = config.check("maxOutliers", yarp::os::Value(3), "consecutive outliers after which the previous result is dropped").asInt();
+        skinPolicy = config.check("skinPolicy", yarp::os::Value("latest"), "skin events processed when the callback falls behind (all / latest)").asString();
+        skinMaxAge = config.check("skinMaxAge", yarp::os::Value(0.0), "age of a skin event above which it is discarded, 0 to disable [s]").asDouble();
+        skinSource = config.check("skinSource", yarp::os::Value(""), "skin events port, if given connected only while calibrating or recording").asString();
+
+        if (estimatorType == "kalman")
+        {
+            leftArm.estimator.reset(new KalmanOffsetEstimator(measurementNoise, initialStd, priorDrift,
+                                                              outlierGate, minSamplesPrior, maxOutliers));
+            rightArm.estimator.reset(new KalmanOffsetEstimator(measurementNoise, initialStd, priorDrift,
+                                                               outlierGate, minSamplesPrior, maxOutliers));
+        }
+    }
+
+    /********************************************************/
+    static Processing *create(yarp::os::ResourceFinder &rf)
+    {
+        return create(rf, rf);
+    }
+
+    /********************************************************/
+    // Parameters are read from config, e.g. the settings of one robot of
+    // a multi-robot server, files are looked up through rf
+    static Processing *create(yarp::os::ResourceFinder &rf, const yarp::os::Searchable &config)
+    {
+        std::string moduleName = config.check("name", yarp::os::Value("calibOffsets"), "module name (string)").asString();
+        std::string robotName = config.check("robot", yarp::os::Value("icub"), "robot name (string)").asString();
+
+        if (!config.check("homePos") || !config.check("homeVels"))
+        {
+            yError() << "Could not find homePos or homeVels";
+            return NULL;
+        }
+
+        CalibParams params;
+        std::string error;
+        if (!params.fromConfig(config, error))
+        {
+            yError() << error;
+            return NULL;
+        }
+
+        RobotInterface *robot;
+        if (config.check("simulate"))
+        {
+            yInfo() << "Running on the simulated robot";
+            robot = SimRobot::create(moduleName, config);
+        }
+        else
+        {
+            double openTimeout = config.check("openTimeout", yarp::os::Value(10.0), "time given to each device to open [s]").asDouble();
+            bool lazyOpen = config.check("lazyOpen", yarp::os::Value(false), "open the devices of an arm only when the arm is first requested").asBool();
+            std::string gazeRemote = config.check("gazeRemote", yarp::os::Value("/iKinGazeCtrl"), "port prefix of the gaze controller of the robot").asString();
+            robot = new YarpRobot(moduleName, robotName, gazeRemote, openTimeout, lazyOpen);
+        }
+
+        return new Processing(params, config, robot, rf);
+    }
+
+    /********************************************************/
+    ~Processing()
+    {
+        delete robot;
+    };
+
+    /********************************************************/
+    bool open()
+    {
+        this->useCallback();
+
+        // strict keeps every event queued, otherwise an event not yet
+        // read is replaced by the newer one
+        this->setStrict(skinPolicy == "all");
+        BufferedPort<SkinEvent>::open( "/" + moduleName + "/handSkin:i" );
+        trackerInPort.configure(trackerBufferSize, &recorder);
+        trackerInPort.open("/" + moduleName + "/tracker:i");
+        offsetsOutPort.open("/" + moduleName + "/offsets:o");
+
+        nextJob = 0;
+        closing = false;
+        leftArm.estimator->init(params->filterOrder + 1);
+        rightArm.estimator->init(params->filterOrder + 1);
+
+        store.configure(storeDir, robotName);
+        loadResult(leftArm);
+        loadResult(rightArm);
+
+        if (!robot->open())
+        {
+            yError() << "Could not open arm / gaze interface";
+            return false;
+        }
+        if (robot->isArmOpen(leftArm.id))
+        {
+            prepareArm(leftArm);
+        }
+        if (robot->isArmOpen(rightArm.id))
+        {
+            prepareArm(rightArm);
+        }
+
+        std::vector<ArmContext*> arms;
+        arms.push_back(&leftArm);
+        arms.push_back(&rightArm);
+        poseCache.configure(robot, arms, poseBufferSize, &recorder);
+        if (!poseCache.start())
+        {
+            yError() << "Could not start the pose cache";
+            return false;
+        }
+
+        oLeft = "";
+        oRight = "";
+
+        return true;
+    }
+
+    /********************************************************/
+    // Opens the devices of the arm the first time it is needed, in lazy
+    // mode, and sets its joints in position mode at the home speeds
+    bool prepareArm(ArmContext &arm)
+    {
+        std::lock_guard<std::mutex> lg(mtx_open);
+        if (arm.nAxes > 0)
+        {
+            return true;
+        }
+        if (!robot->openArm(arm.id))
+        {
+            yError() << "Could not open the" << arm.name << "arm devices";
+            return false;
+        }
+        for (size_t j=0; j<homeVels.length(); j++)
+        {
+            robot->setPositionMode(arm.id,j);
+            robot->setRefSpeed(arm.id,j,homeVels[j]);
+        }
+        arm.nAxes = robot->getAxes(arm.id);
+        return true;
+    }
+
+    /********************************************************/
+    std::shared_ptr<const CalibParams> getParams() const
+    {
+        return std::atomic_load(&params);
+    }
+
+    /********************************************************/
+    static time_t modificationTime(const std::string &file)
+    {
+        struct stat st;
+        if (file.empty() || (::stat(file.c_str(), &st) != 0))
+        {
+            return 0;
+        }
+        return st.st_mtime;
+    }
+
+    /********************************************************/
+    // Reads the thresholds and the calibration poses again from the
+    // configuration file and swaps them in between two skin events;
+    // nothing changes if any value is rejected. The values given on the
+    // command line and the robot group are applied over the file again,
+    // in the order used at startup.
+    bool reloadConfig()
+    {
+        time_t t = modificationTime(configFile);
+        yarp::os::Property config;
+        if (configFile.empty() || !config.fromConfigFile(configFile))
+        {
+            yError() << "Could not read configuration file" << configFile;
+            return false;
+        }
+        config.fromString(overrides.toString(), false);
+        applyGroup(config, configGroup);
+
+        std::shared_ptr<CalibParams> next = std::make_shared<CalibParams>();
+        std::string error;
+        if (!next->fromConfig(config, error))
+        {
+            yError() << "Configuration not reloaded:" << error;
+            rejectedTime = t;
+            return false;
+        }
+        std::atomic_store(&params, std::shared_ptr<const CalibParams>(next));
+        configTime = t;
+        yInfo() << "Reloaded configuration from" << configFile;
+        return true;
+    }
+
+    /********************************************************/
+    // Puts the settings of a group of config, e.g. the one of a robot
+    // served by a multi-robot server, over the common ones
+    static void applyGroup(yarp::os::Property &config, const std::string &group)
+    {
+        if (group.empty())
+        {
+            return;
+        }
+        yarp::os::Bottle &settings = config.findGroup(group);
+        if (!settings.isNull())
+        {
+            config.fromString(settings.tail().toString(), false);
+        }
+    }
+
+    /********************************************************/
+    // Reloads the configuration if the file changed since it was last
+    // applied; a rejected version is not retried until edited again
+    bool checkConfig()
+    {
+        time_t t = modificationTime(configFile);
+        if ((t == 0) || (t == configTime) || (t == rejectedTime))
+        {
+            return false;
+        }
+        return reloadConfig();
+    }
+
+    /********************************************************/
+    // Values given on the command line, applied over the file on reload
+    void setOverrides(const yarp::os::Property &overrides)
+    {
+        this->overrides = overrides;
+    }
+
+    /********************************************************/
+    // reach_offset and grasp_offset of demoRedBall for the arm: the ball
+    // is reached from the side, one diameter away from the palm
+    void demoOffsets(const ArmContext &arm, std::string &reach, std::string &grasp) const
+    {
+        std::shared_ptr<const CalibParams> p = getParams();
+        const yarp::sig::Vector &offset = arm.getSnapshot()->offset;
+        double side = (arm.id == leftArm.id) ? -1.0 : 1.0;
+        reach = std::to_string(offset[0] + p->xOffset) + " " +
+                std::to_string(offset[1] + side*2*p->ballRadius) + " " +
+                std::to_string(offset[2]);
+        grasp = std::to_string(offset[0] + p->xOffset) + " " +
+                std::to_string(offset[1]) + " " +
+                std::to_string(offset[2]);
+    }
+
+    /********************************************************/
+    // Sets key to value in [section] of the lines of an INI file, adding
+    // the key or the section when missing and leaving the rest untouched
+    static void patchIni(std::vector<std::string> &lines, const std::string &section,
+                         const std::string &key, const std::string &value)
+    {
+        auto trim = [](const std::string &str)
+        {
+            size_t b = str.find_first_not_of(" \t\r");
+            size_t e = str.find_last_not_of(" \t\r");
+            return (b == std::string::npos) ? std::string() : str.substr(b, e - b + 1);
+        };
+
+        size_t header = lines.size();
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            if (trim(lines[i]) == "[" + section + "]")
+            {
+                header = i;
+                break;
+            }
+        }
+        if (header == lines.size())
+        {
+            lines.push_back("");
+            lines.push_back("[" + section + "]");
+            header = lines.size() - 1;
+        }
+
+        for (size_t i = header + 1; i < lines.size(); i++)
+        {
+            std::string line = trim(lines[i]);
+            if (!line.empty() && (line[0] == '['))
+            {
+                break;
+            }
+            std::istringstream tokens(line);
+            std::string first;
+            tokens >> first;
+            if (first == key)
+            {
+                lines[i] = key + "\t" + value;
+                return;
+            }
+        }
+        lines.insert(lines.begin() + header + 1, key + "\t" + value);
+    }
+
+    /********************************************************/
+    // Patches reach_offset / grasp_offset of the calibrated arms in a
+    // file of a context, e.g. config.ini of demoRedBall, in one atomic
+    // write. The file found in the context, possibly the installed copy,
+    // is written to the home context, as yarp-config context --import
+    // does; the path written is returned, empty on failure.
+    std::string exportTo(const std::string &context, const std::string &file)
+    {
+        if (!leftArm.calibrated && !rightArm.calibrated)
+        {
+            yInfo() << "Left / right arm not yet calibrated";
+            return "";
+        }
+
+        yarp::os::ResourceFinder finder;
+        finder.setQuiet();
+        finder.setDefaultContext(context);
+        finder.configure(0, NULL);
+        std::string source = finder.findFileByName(file);
+        if (source.empty())
+        {
+            yError() << "Could not find" << file << "in context" << context;
+            return "";
+        }
+        std::string dir = finder.getHomeContextPath();
+        if (dir.empty() || (yarp::os::mkdir_p(dir.c_str()) != 0))
+        {
+            yError() << "Could not create the home context of" << context;
+            return "";
+        }
+        std::string path = dir + "/" + file;
+
+        std::ifstream in(source);
+        if (!in.is_open())
+        {
+            yError() << "Could not read" << source;
+            return "";
+        }
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            lines.push_back(line);
+        }
+        in.close();
+
+        std::string reach, grasp;
+        std::vector<ArmContext*> arms;
+        arms.push_back(&leftArm);
+        arms.push_back(&rightArm);
+        for (size_t i = 0; i < arms.size(); i++)
+        {
+            if (arms[i]->calibrated)
+            {
+                demoOffsets(*arms[i], reach, grasp);
+                patchIni(lines, arms[i]->name + "_arm", "reach_offset", reach);
+                patchIni(lines, arms[i]->name + "_arm", "grasp_offset", grasp);
+            }
+        }
+
+        std::string content;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            content += lines[i] + "\n";
+        }
+        if (!ResultStore::writeAtomically(path, content))
+        {
+            yError() << "Could not write" << path;
+            return "";
+        }
+        yInfo() << "Exported offsets to" << path;
+        return path;
+    }
+
+    /********************************************************/
+    bool writeToFile(const std::string &part)
+    {
+        if (part == "left" && !leftArm.calibrated)
+        {
+            yInfo() << "Left arm not yet calibrated";
+            return false;
+        }
+        if (part == "right" && !rightArm.calibrated)
+        {
+            yInfo() << "Right arm not yet calibrated";
+            return false;
+        }
+        if (part == "both" && (!rightArm.calibrated || !leftArm.calibrated))
+        {
+            yInfo() << "Left / right arm not yet calibrated";
+            return false;
+        }
+
+        std::string filePath = rf.getHomeContextPath().c_str();
+        std::string reach, grasp;
+        // LEFT_ARM
+        if (leftArm.calibrated)
+        {
+            demoOffsets(leftArm, reach, grasp);
+            oLeft = "[left_arm] \n";
+            oLeft += "reach_offset \t" + reach + "\n";
+            oLeft += "grasp_offset \t" + grasp + "\n";
+        }
+        // RIGHT_ARM
+        if (rightArm.calibrated)
+        {
+            demoOffsets(rightArm, reach, grasp);
+            oRight = "[right_arm] \n";
+            oRight += "reach_offset \t" + reach + "\n";
+            oRight += "grasp_offset \t" + grasp + "\n";
+        }
+
+        // one file per robot, as for the result store; readers never see
+        // a half-written file
+        std::string resultsFile = filePath + "/calibOffsetsResults_" + robotName + ".txt";
+        if (ResultStore::writeAtomically(resultsFile, oLeft + "\n" + oRight))
+        {
+            yInfo() << "Written" << part << "to" << resultsFile;
+            return true;
+        }
+        else
+        {
+            yError() << "Could not write the file";
+            return false;
+        }
+        // RUNNING THE SCRIPT FOR THE AUTOMATIC EXPORT OF calibOffsetsResults.txt TO demoRedBall config.ini
+        //std::string command = "/bin/bash -c '" + script_path + "/exportOffsetToDemoRedBall.sh " + path + "/calibOffsetsResults.txt'";
+        //yDebug() << "command: " << command;
+        //system(command.c_str());
+    }
+
+    /********************************************************/
+    // Cancels the jobs and waits for them to end, so that nothing holds
+    // the devices any longer
+    void cancelJobs()
+    {
+        closing = true;
+        {
+            std::lock_guard<std::mutex> lg(mtx_jobs);
+            for (auto &it : jobs)
+            {
+                it.second->cancelled = true;
+            }
+        }
+        stopCalibrating(leftArm, SessionRecorder::CANCEL);
+        stopCalibrating(rightArm, SessionRecorder::CANCEL);
+        {
+            std::lock_guard<std::mutex> lg(mtx_jobs);
+            for (auto &it : jobs)
+            {
+                if (it.second->worker.joinable())
+                {
+                    it.second->worker.join();
+                }
+            }
+        }
+    }
+
+    /********************************************************/
+    void close()
+    {
+        cancelJobs();
+
+        BufferedPort<SkinEvent>::close();
+        {
+            std::unique_lock<std::mutex> lk(mtx_queue);
+            skinQueue.clear();
+            queueDrained.wait(lk, [this]() { return !drainScheduled; });
+        }
+        trackerInPort.close();
+        offsetsOutPort.close();
+        if (poseCache.isRunning())
+        {
+            poseCache.stop();
+        }
+        recorder.close();
+
+        robot->close();
+    }
+
+    /********************************************************/
+    void interrupt()
+    {
+        cancelJobs();
+        home();
+        BufferedPort<SkinEvent>::interrupt();
+        trackerInPort.interrupt();
+        offsetsOutPort.interrupt();
+    }
+
+    /********************************************************/
+    ArmContext *getArm(const std::string &part)
+    {
+        if (part == "left")
+        {
+            return &leftArm;
+        }
+        else if (part == "right")
+        {
+            return &rightArm;
+        }
+        return NULL;
+    }
+
+    /********************************************************/
+    ArmContext *getArm(const SkinEvent::Contact &contact)
+    {
+        if (leftArm.owns(contact))
+        {
+            return &leftArm;
+        }
+        else if (rightArm.owns(contact))
+        {
+            return &rightArm;
+        }
+        return NULL;
+    }
+
+    /********************************************************/
+    void onRead( SkinEvent &inSkin )
+    {
+        // nothing to calibrate nor to record: the sequence numbers are
+        // restarted, so that the events skipped are not counted as dropped
+        inSkin.setIdleFlag(skinIdle);
+        if (inSkin.isSkipped() || isIdle())
+        {
+            stats.idleEvents++;
+            lastSkinCount = -1;
+            return;
+        }
+
+        yarp::os::Stamp skinStamp;
+        double tSkin = yarp::os::Time::now();
+        if (getEnvelope(skinStamp) && skinStamp.isValid())
+        {
+            tSkin = skinStamp.getTime();
+            countDropped(skinStamp.getCount());
+        }
+        else
+        {
+            skinStamp = yarp::os::Stamp(0, tSkin);
+        }
+
+        if (recorder.isActive())
+        {
+            recorder.recordSkin(tSkin, inSkin);
+        }
+        if (pool != NULL)
+        {
+            enqueueSkin(inSkin, skinStamp);
+            return;
+        }
+        if (!isStale(tSkin))
+        {
+            processSkin(inSkin, tSkin);
+        }
+    }
+
+    /********************************************************/
+    bool isIdle() const
+    {
+        return !leftArm.calibrating && !rightArm.calibrating && !recorder.isActive();
+    }
+
+    /********************************************************/
+    // Refreshes the flag the skin reader checks before decoding; called
+    // after every change of isIdle, serialized so the last store holds
+    // the current state
+    void updateIdle()
+    {
+        std::lock_guard<std::mutex> lg(mtx_idle);
+        *skinIdle = isIdle();
+    }
+
+    /********************************************************/
+    // With a skinSource the module subscribes to the skin events only
+    // while it needs them; otherwise the connection is left to the app
+    void subscribeSkin(const bool on)
+    {
+        std::lock_guard<std::mutex> lg(mtx_subscription);
+        if (skinSource.empty() || (on == skinConnected))
+        {
+            return;
+        }
+        std::string port = "/" + moduleName + "/handSkin:i";
+        if (on)
+        {
+            if (!yarp::os::Network::connect(skinSource, port))
+            {
+                yWarning() << "Could not connect" << skinSource << "to" << port;
+                return;
+            }
+            yInfo() << "Subscribed to" << skinSource;
+        }
+        else
+        {
+            yarp::os::Network::disconnect(skinSource, port);
+            yInfo() << "Unsubscribed from" << skinSource;
+        }
+        skinConnected = on;
+    }
+
+    /********************************************************/
+    // Drops the subscription once idle; a motion towards a calibration
+    // pose holds mtx_devices and keeps it until the calibration starts
+    void updateSubscription()
+    {
+        if (skinSource.empty() || !skinConnected || !isIdle())
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lk(mtx_devices, std::try_to_lock);
+        if (lk.owns_lock())
+        {
+            subscribeSkin(false);
+        }
+    }
+
+    /********************************************************/
+    // Events the port replaced before they were read, or lost on the
+    // way, show up as gaps in the envelope sequence numbers
+    void countDropped(const int count)
+    {
+        if ((lastSkinCount >= 0) && (count > lastSkinCount + 1))
+        {
+            stats.droppedEvents += count - lastSkinCount - 1;
+        }
+        lastSkinCount = count;
+    }
+
+    /********************************************************/
+    bool isStale(const double tSkin)
+    {
+        if ((skinMaxAge > 0.0) && (yarp::os::Time::now() - tSkin > skinMaxAge))
+        {
+            stats.staleEvents++;
+            return true;
+        }
+        return false;
+    }
+
+    /********************************************************/
+    // Hands the skin events over to the threads of a multi-robot server
+    // instead of processing them on the port callback
+    void setPool(WorkerPool *pool)
+    {
+        this->pool = pool;
+    }
+
+    /********************************************************/
+    void enqueueSkin(const SkinEvent &inSkin, const yarp::os::Stamp &stamp)
+    {
+        std::lock_guard<std::mutex> lg(mtx_queue);
+        if (skinPolicy != "all")
+        {
+            stats.droppedEvents += skinQueue.size();
+            skinQueue.clear();
+        }
+        skinQueue.push_back(std::make_pair(stamp, inSkin));
+        if (!drainScheduled)
+        {
+            drainScheduled = true;
+            pool->post([this]() { drainSkin(); });
+        }
+    }
+
+    /********************************************************/
+    // Processes the queued events; after a batch the rest is posted
+    // again, so that a busy robot does not hold a thread of the pool
+    void drainSkin()
+    {
+        const int batch = 16;
+        for (int n = 0; ; n++)
+        {
+            std::pair<yarp::os::Stamp, SkinEvent> event;
+            {
+                std::lock_guard<std::mutex> lg(mtx_queue);
+                if (skinQueue.empty())
+                {
+                    drainScheduled = false;
+                    queueDrained.notify_all();
+                    return;
+                }
+                if (n == batch)
+                {
+                    pool->post([this]() { drainSkin(); });
+                    return;
+                }
+                event = std::move(skinQueue.front());
+                skinQueue.pop_front();
+            }
+            if (!isStale(event.first.getTime()))
+            {
+                processSkin(event.second, event.first.getTime());
+            }
+        }
+    }
+
+    /********************************************************/
+    // Estimation pipeline for one skinManager event stamped tSkin, shared
+    // by the live callback and the replay of recorded sessions
+    void processSkin( const SkinEvent &inSkin, const double tSkin )
+    {
+        std::chrono::steady_clock::time_point tEvent = std::chrono::steady_clock::now();
+        stats.eventsReceived++;
+        stats.latency[CalibStats::DECODE].add(inSkin.getDecodeTime());
+
+        std::shared_ptr<const CalibParams> p = getParams();
+        for (size_t j=0; j < inSkin.size(); j++)
+        {
+            StageTimer timer(stats);
+            const SkinEvent::Contact &contact = inSkin[j];
+            ArmContext *arm = getArm(contact);
+            if (arm != NULL && arm->calibrating)
+            {
+                stats.contactsHandled++;
+                if (verbose)
+                {
+                    yInfo() << "Starting calibration" << arm->name;
+                }
+                double avgPressure = contact.pressure;
+                timer.lap(CalibStats::ROUTE);
+                if (avgPressure >= p->skinPressureThresh)
+                {
+                    double countActive = p->taxelMask[arm->id].score(inSkin.taxels(contact), contact.taxelsCount);
+                    timer.lap(CalibStats::TAXELS);
+                    if (verbose)
+                    {
+                        yInfo() << "Found" << countActive << "palm active taxels";
+                    }
+
+                    if (countActive >= p->activeTaxelsThresh)
+                    {
+                        yarp::sig::Vector ballPos;
+                        double ballLikelihood;
+                        bool tracked = trackerInPort.getSample(tSkin, trackerMaxSkew, ballPos, ballLikelihood);
+                        timer.lap(CalibStats::TRACKER);
+                        if (!tracked)
+                        {
+                            if (verbose)
+                            {
+                                yDebug() << "No tracker sample within" << trackerMaxSkew << "s of the skin event";
+                            }
+                            stats.missedTracker++;
+                            arm->countRejected++;
+                        }
+                        else
+                        {
+                            yarp::sig::Matrix eye2root;
+                            yarp::sig::Vector xHand;
+                            bool posed = false;
+                            if (ballLikelihood > p->ballLikelihoodThresh)
+                            {
+                                posed = poseCache.getEyePose(tSkin, poseMaxSkew, eye2root) &&
+                                        arm->handPositions.nearest(tSkin, poseMaxSkew, xHand);
+                                timer.lap(CalibStats::POSES);
+                            }
+                            if (ballLikelihood <= p->ballLikelihoodThresh)
+                            {
+                                if (verbose)
+                                {
+                                    yDebug() << "Ball likelihood" << ballLikelihood << "below threshold";
+                                }
+                                stats.rejectedLikelihood++;
+                                arm->countRejected++;
+                            }
+                            else if (!posed)
+                            {
+                                if (verbose)
+                                {
+                                    yDebug() << "No eye / hand pose within" << poseMaxSkew << "s of the skin event";
+                                }
+                                stats.missedPoses++;
+                                arm->countRejected++;
+                            }
+                            else if (!isSteady(*arm, tSkin))
+                            {
+                                arm->countRejected++;
+                                timer.lap(CalibStats::GATE);
+                            }
+                            else
+                            {
+                                timer.lap(CalibStats::GATE);
+                                yarp::sig::Vector posBallEye(4);
+                                posBallEye[0] = ballPos[0];
+                                posBallEye[1] = ballPos[1];
+                                posBallEye[2] = ballPos[2];
+                                posBallEye[3] = 1.0;
+
+                                yarp::sig::Vector posBallRoot = eye2root * posBallEye;
+                                posBallRoot.pop_back();
+                                if (verbose)
+                                {
+                                    yDebug() << "Ball pos root" << posBallRoot.toString();
+                                    yDebug() << "Hand Effector" << xHand.toString();
+                                }
+
+                                yarp::sig::Vector offset(3);
+                                offset[0] = xHand[0] - posBallRoot[0];
+                                offset[1] = xHand[1] - posBallRoot[1];
+                                offset[2] = xHand[2] - posBallRoot[2];
+                                if (verbose)
+                                {
+                                    yDebug() << "Offset" << offset[0] << offset[1] << offset[2];
+                                }
+
+                                // the arm may have been stopped or restarted meanwhile
+                                std::lock_guard<std::mutex> lg(arm->mtx_estimate);
+                                if (!arm->calibrating)
+                                {
+                                    continue;
+                                }
+                                if (!arm->estimator->add(offset))
+                                {
+                                    if (verbose)
+                                    {
+                                        yDebug() << "Offset outside the validation gate";
+                                    }
+                                    stats.rejectedOutliers++;
+                                    arm->countRejected++;
+                                    continue;
+                                }
+                                arm->countOffset++;
+                                stats.accepted++;
+
+                                arm->rawOffsets.push_back(offset);
+                                arm->filteredOffset=arm->estimator->getEstimate();
+                                timer.lap(CalibStats::ESTIMATOR);
+                                if (verbose)
+                                {
+                                    yDebug() << "Offset spread" << arm->estimator->getSpread().toString();
+                                }
+
+                                // stop as soon as the estimate has settled, filterOrder
+                                // only bounds the number of samples collected
+                                bool converged = arm->estimator->converged(minSamples, convergenceTol);
+                                arm->publish(tSkin, converged);
+                                streamOffset(*arm);
+                                if(converged || arm->countOffset > p->filterOrder)
+                                {
+                                    if (!converged)
+                                    {
+                                        yWarning() << "Spread" << arm->estimator->getSpread().toString()
+                                                   << "still above" << convergenceTol << "after" << arm->countOffset << "samples";
+                                    }
+                                    yDebug() << "Filtered offset" << arm->name << arm->filteredOffset.toString();
+                                    arm->notifyCalibrated(converged);
+                                    updateIdle();
+                                }
+                            }
+                        }
+                    }
+                    else
+                    {
+                        stats.filteredTaxels++;
+                        arm->countRejected++;
+                    }
+                }
+                else
+                {
+                    stats.filteredPressure++;
+                    arm->countRejected++;
+                }
+            }
+        }
+        stats.latency[CalibStats::EVENT].add(std::chrono::steady_clock::now() - tEvent);
+    }
+
+    /**********************************************************/
+    // Motion gate: a contact is only worth a sample if the arm, the gaze
+    // and the ball were all still when it happened. Checks without data,
+    // e.g. when replaying a session recorded without the joint and head
+    // speeds, let the sample through.
+    bool isSteady(ArmContext &arm, const double tSkin)
+    {
+        double speed;
+        if ((gateJointSpeed > 0.0) && arm.jointSpeeds.nearest(tSkin, poseMaxSkew, speed) &&
+            (speed > gateJointSpeed))
+        {
+            if (verbose)
+            {
+                yDebug() << "Arm joints moving at" << speed << "deg/s";
+            }
+            stats.rejectedArmMotion++;
+            return false;
+        }
+
+        if ((gateGazeSpeed > 0.0) && poseCache.getHeadSpeed(tSkin, poseMaxSkew, speed) &&
+            (speed > gateGazeSpeed))
+        {
+            if (verbose)
+            {
+                yDebug() << "Gaze moving at" << speed << "deg/s";
+            }
+            stats.rejectedGazeMotion++;
+            return false;
+        }
+
+        double jitter;
+        if ((gateBallJitter > 0.0) && trackerInPort.getJitter(tSkin, gateWindow, jitter) &&
+            (jitter > gateBallJitter))
+        {
+            if (verbose)
+            {
+                yDebug() << "Ball jitter" << jitter << "m";
+            }
+            stats.rejectedBallJitter++;
+            return false;
+        }
+        return true;
+    }
+
+    /**********************************************************/
+    // Streams the latest snapshot of the arm on offsets:o as
+    // (part <name>) (offset x y z) (spread x y z) (count n) (converged 0/1),
+    // with the snapshot version and stamp in the envelope
+    void streamOffset(const ArmContext &arm)
+    {
+        if (offsetsOutPort.getOutputCount() == 0)
+        {
+            return;
+        }
+
+        std::shared_ptr<const OffsetSnapshot> snapshot = arm.getSnapshot();
+        yarp::os::Bottle &out = offsetsOutPort.prepare();
+        out.clear();
+        yarp::os::Bottle &part = out.addList();
+        part.addString("part");
+        part.addString(arm.name);
+        yarp::os::Bottle &offset = out.addList();
+        offset.addString("offset");
+        yarp::os::Bottle &spread = out.addList();
+        spread.addString("spread");
+        for (size_t k = 0; k < 3; k++)
+        {
+            offset.addDouble(snapshot->offset[k]);
+            spread.addDouble(snapshot->spread[k]);
+        }
+        yarp::os::Bottle &count = out.addList();
+        count.addString("count");
+        count.addInt(snapshot->count);
+        yarp::os::Bottle &converged = out.addList();
+        converged.addString("converged");
+        converged.addInt(snapshot->converged ? 1 : 0);
+
+        yarp::os::Stamp stamp((int)snapshot->version, snapshot->stamp);
+        offsetsOutPort.setEnvelope(stamp);
+        offsetsOutPort.write();
+    }
+
+    /**********************************************************/
+    yarp::os::Bottle getStats()
+    {
+        return stats.toBottle();
+    }
+
+    /**********************************************************/
+    bool startRecording(const std::string &file)
+    {
+        if (!recorder.open(file))
+        {
+            yError() << "Could not open" << file << "for recording";
+            return false;
+        }
+        yInfo() << "Recording to" << file;
+        updateIdle();
+        subscribeSkin(true);
+        return true;
+    }
+
+    /**********************************************************/
+    bool stopRecording()
+    {
+        if (!recorder.isActive())
+        {
+            return false;
+        }
+        recorder.close();
+        updateIdle();
+        yInfo() << "Recording stopped";
+        return true;
+    }
+
+    /**********************************************************/
+    // Offline use of the estimation pipeline (replay, benchmarks): the
+    // tracker and pose buffers are fed by the caller instead of the
+    // ports and the pose thread, and skin events go to processSkin
+    void openOffline()
+    {
+        std::vector<ArmContext*> arms;
+        arms.push_back(&leftArm);
+        arms.push_back(&rightArm);
+        trackerInPort.configure(trackerBufferSize, NULL);
+        poseCache.configure(NULL, arms, poseBufferSize, NULL);
+        resetArm(leftArm, false);
+        resetArm(rightArm, false);
+        stats.reset();
+    }
+
+    /**********************************************************/
+    void feedTracker(const double t, const double x, const double y, const double z,
+                     const double likelihood)
+    {
+        trackerInPort.push(t, x, y, z, likelihood);
+    }
+
+    /**********************************************************/
+    void feedEyePose(const double t, const yarp::sig::Matrix &eye2root)
+    {
+        poseCache.pushEye(t, eye2root);
+    }
+
+    /**********************************************************/
+    void feedHandPosition(const int arm, const double t, const yarp::sig::Vector &x)
+    {
+        poseCache.pushHand((arm == leftArm.id) ? leftArm : rightArm, t, x);
+    }
+
+    /**********************************************************/
+    void feedJointSpeed(const int arm, const double t, const double speed)
+    {
+        poseCache.pushJointSpeed((arm == leftArm.id) ? leftArm : rightArm, t, speed);
+    }
+
+    /**********************************************************/
+    void feedHeadSpeed(const double t, const double speed)
+    {
+        poseCache.pushHeadSpeed(t, speed);
+    }
+
+    /**********************************************************/
+    // A prior, if given, warm starts the estimator as it did live
+    void startOffline(const int arm, const yarp::sig::Vector &priorOffset = yarp::sig::Vector(),
+                      const yarp::sig::Vector &priorSpread = yarp::sig::Vector())
+    {
+        ArmContext &ctx = (arm == leftArm.id) ? leftArm : rightArm;
+        resetArm(ctx, false);
+        if ((priorOffset.length() == 3) && (priorSpread.length() == 3))
+        {
+            ctx.estimator->setPrior(priorOffset, priorSpread);
+        }
+        ctx.calibrating = true;
+    }
+
+    /**********************************************************/
+    bool isCalibrating(const int arm) const
+    {
+        return (arm == leftArm.id) ? leftArm.calibrating : rightArm.calibrating;
+    }
+
+    /**********************************************************/
+    // Runs a recorded session through the estimation pipeline as fast as
+    // possible, without devices nor network
+    bool replay(const std::string &file)
+    {
+        SessionReader reader;
+        if (!reader.open(file))
+        {
+            yError() << "Could not read session log" << file;
+            return false;
+        }
+
+        openOffline();
+
+        uint8_t type;
+        double t;
+        std::vector<char> payload;
+        double data[16];
+        SkinEvent skin;
+        size_t nSkin = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        while (reader.next(type, t, payload))
+        {
+            if (type == SessionRecorder::SKIN)
+            {
+                if (!skin.fromBinary(payload.data(), payload.size()))
+                {
+                    yWarning() << "Skipping malformed skin event at" << t;
+                    continue;
+                }
+                processSkin(skin, t);
+                nSkin++;
+                continue;
+            }
+
+            if (payload.size() > sizeof(data))
+            {
+                yWarning() << "Skipping malformed record of type" << (int)type;
+                continue;
+            }
+            memcpy(data, payload.data(), payload.size());
+            if ((type == SessionRecorder::TRACKER) && (payload.size() == 4*sizeof(double)))
+            {
+                feedTracker(t, data[0], data[1], data[2], data[3]);
+            }
+            else if ((type == SessionRecorder::EYE) && (payload.size() == 16*sizeof(double)))
+            {
+                yarp::sig::Matrix eye2root(4, 4);
+                for (size_t r = 0; r < 4; r++)
+                {
+                    for (size_t c = 0; c < 4; c++)
+                    {
+                        eye2root(r, c) = data[4*r + c];
+                    }
+                }
+                feedEyePose(t, eye2root);
+            }
+            else if ((type == SessionRecorder::HAND) && (payload.size() == 4*sizeof(double)))
+            {
+                yarp::sig::Vector x(3);
+                x[0] = data[1];
+                x[1] = data[2];
+                x[2] = data[3];
+                feedHandPosition((int)data[0], t, x);
+            }
+            else if ((type == SessionRecorder::JOINT_SPEED) && (payload.size() == 2*sizeof(double)))
+            {
+                feedJointSpeed((int)data[0], t, data[1]);
+            }
+            else if ((type == SessionRecorder::HEAD_SPEED) && (payload.size() == sizeof(double)))
+            {
+                feedHeadSpeed(t, data[0]);
+            }
+            else if ((type == SessionRecorder::START) && (payload.size() == sizeof(double)))
+            {
+                startOffline((int)data[0]);
+            }
+            else if ((type == SessionRecorder::START) && (payload.size() == 7*sizeof(double)))
+            {
+                yarp::sig::Vector priorOffset(3), priorSpread(3);
+                for (size_t k = 0; k < 3; k++)
+                {
+                    priorOffset[k] = data[1 + k];
+                    priorSpread[k] = data[4 + k];
+                }
+                startOffline((int)data[0], priorOffset, priorSpread);
+            }
+            else if ((type == SessionRecorder::STOP) && (payload.size() == 2*sizeof(double)))
+            {
+                ArmContext &arm = (data[0] == 0.0) ? leftArm : rightArm;
+                arm.stopCalibrating();
+                yInfo() << "Calibration of" << arm.name << "stopped by"
+                        << ((data[1] == SessionRecorder::CANCEL) ? "cancel" : "timeout");
+            }
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        std::vector<ArmContext*> arms;
+        arms.push_back(&leftArm);
+        arms.push_back(&rightArm);
+        yInfo() << "Replayed" << nSkin << "skin events in" << elapsed << "s ("
+                << ((elapsed > 0.0) ? nSkin / elapsed : 0.0) << "events/s)";
+        for (size_t i = 0; i < arms.size(); i++)
+        {
+            yInfo() << arms[i]->name << (arms[i]->calibrated ? "calibrated" : "not calibrated")
+                    << "with" << arms[i]->countOffset << "samples, offset"
+                    << arms[i]->filteredOffset.toString() << "spread"
+                    << arms[i]->estimator->getSpread().toString();
+        }
+        yInfo() << "Stats" << stats.toBottle().toString();
+        return true;
+    }
+
+    /**********************************************************/
+    std::vector<double> getOffset(const std::string part)
+    {
+        std::vector<double> tmpOffset(3);
+        ArmContext *arm = getArm(part);
+        if (arm != NULL)
+        {
+            std::shared_ptr<const OffsetSnapshot> snapshot = arm->getSnapshot();
+            tmpOffset[0] = snapshot->offset[0];
+            tmpOffset[1] = snapshot->offset[1];
+            tmpOffset[2] = snapshot->offset[2];
+        }
+
+        return tmpOffset;
+    }
+
+    /**********************************************************/
+    // Offset field lookup, falling back to the single offset when the
+    // part has no field yet
+    std::vector<double> getOffsetAt(const std::string &part, const double x, const double y,
+                                    const double z)
+    {
+        std::vector<double> tmpOffset(3);
+        ArmContext *arm = getArm(part);
+        if (arm != NULL)
+        {
+            yarp::sig::Vector o;
+            std::shared_ptr<const OffsetField> field = arm->getField();
+            if (!field || !field->lookup(x, y, z, o))
+            {
+                o = arm->getSnapshot()->offset;
+            }
+            tmpOffset[0] = o[0];
+            tmpOffset[1] = o[1];
+            tmpOffset[2] = o[2];
+        }
+
+        return tmpOffset;
+    }
+
+    /**********************************************************/
+    // Calibrates at every position of the part field grid and builds
+    // the offset field from the hand positions and offsets measured
+    bool calibrateField(const std::string &part, const int timeout)
+    {
+        ArmContext *arm = getArm(part);
+        if (arm == NULL)
+        {
+            yError() << "Part not handled" << part;
+            return false;
+        }
+        if (arm->fieldPositions.empty())
+        {
+            yError() << "No field positions configured for" << part;
+            return false;
+        }
+        if (!prepareArm(*arm))
+        {
+            return false;
+        }
+        return runSync(part, timeout, true) == "completed";
+    }
+
+    /**********************************************************/
+    bool measureField(const std::string &part, const int timeout)
+    {
+        ArmContext *arm = getArm(part);
+        OffsetField field;
+        yarp::sig::Vector none;
+        for (size_t i = 0; (i < arm->fieldPositions.size()) && !isCancelled(); i++)
+        {
+            yInfo() << "Field position" << i + 1 << "of" << arm->fieldPositions.size();
+            // every grid pose starts cold, so that the field is measured
+            // rather than smoothed towards the previous pose
+            if (!lookAt(*arm, arm->fieldPositions[i], none, timeout, false) || !calibrate(part, timeout))
+            {
+                yWarning() << "Skipping field position" << i + 1;
+                continue;
+            }
+            yarp::sig::Vector x0,o0;
+            robot->getHandPose(arm->id,x0,o0);
+            yarp::sig::Vector offset = arm->getSnapshot()->offset;
+            field.add(x0, offset);
+            yDebug() << "Offset" << offset.toString() << "at" << x0.toString();
+        }
+
+        if (isCancelled() || !field.build(fieldKernelWidth, fieldResolution, fieldMargin))
+        {
+            yError() << "Could not build the offset field of" << part;
+            return false;
+        }
+
+        arm->setField(std::make_shared<OffsetField>(field));
+        yInfo() << "Offset field of" << part << "built from" << field.size() << "positions";
+        return true;
+    }
+
+    /**********************************************************/
+    bool reset()
+    {
+        // a job waiting on the arms wakes up and ends as cancelled
+        std::shared_ptr<CalibrationJob> job = std::atomic_load(&activeJob);
+        if (job && job->running)
+        {
+            job->cancelled = true;
+        }
+        stopCalibrating(leftArm, SessionRecorder::CANCEL);
+        stopCalibrating(rightArm, SessionRecorder::CANCEL);
+        leftArm.calibrated = false;
+        rightArm.calibrated = false;
+        leftArm.setField(nullptr);
+        rightArm.setField(nullptr);
+//        oFile.close();
+//        oFile.open(filePath + "/calibOffsetsResults.txt", std::ios_base::out | std::ios_base::trunc);
+//        if (!oFile.is_open())
+//        {
+//            yError() << "Could not open output file";
+//            return false;
+//        }
+        return true;
+    }
+
+    /**********************************************************/
+    // Appends the result of the last calibration of the arm to the store
+    bool saveResult(ArmContext &arm)
+    {
+        yarp::os::Bottle entry;
+        {
+            std::lock_guard<std::mutex> lg(arm.mtx_estimate);
+            std::shared_ptr<const OffsetSnapshot> snapshot = arm.getSnapshot();
+            yarp::os::Bottle &stamp = entry.addList();
+            stamp.addString("stamp");
+            stamp.addDouble(yarp::os::Time::now());
+            yarp::os::Bottle &offset = entry.addList();
+            offset.addString("offset");
+            yarp::os::Bottle &spread = entry.addList();
+            spread.addString("spread");
+            for (size_t k = 0; k < 3; k++)
+            {
+                offset.addDouble(snapshot->offset[k]);
+                spread.addDouble(snapshot->spread[k]);
+            }
+            yarp::os::Bottle &count = entry.addList();
+            count.addString("count");
+            count.addInt(snapshot->count);
+            yarp::os::Bottle &converged = entry.addList();
+            converged.addString("converged");
+            converged.addInt(snapshot->converged ? 1 : 0);
+            yarp::os::Bottle &pose = entry.addList();
+            pose.addString("pose");
+            for (size_t j = 0; j < arm.target.length(); j++)
+            {
+                pose.addDouble(arm.target[j]);
+            }
+            yarp::os::Bottle &raw = entry.addList();
+            raw.addString("raw");
+            for (size_t i = 0; i < arm.rawOffsets.size(); i++)
+            {
+                yarp::os::Bottle &sample = raw.addList();
+                sample.addDouble(arm.rawOffsets[i][0]);
+                sample.addDouble(arm.rawOffsets[i][1]);
+                sample.addDouble(arm.rawOffsets[i][2]);
+            }
+            arm.prior = snapshot;
+            arm.priorPose = arm.target;
+        }
+
+        if (!store.append(arm.name, entry))
+        {
+            yError() << "Could not store the result of" << arm.name << "in" << storeDir;
+            return false;
+        }
+        return true;
+    }
+
+    /**********************************************************/
+    // Serves the latest stored result of the arm until it is calibrated
+    // again; the arm is not marked calibrated by it
+    void loadResult(ArmContext &arm)
+    {
+        yarp::os::Bottle entry;
+        if (!store.loadLatest(arm.name, entry))
+        {
+            return;
+        }
+
+        yarp::os::Bottle &offset = entry.findGroup("offset");
+        yarp::os::Bottle &spread = entry.findGroup("spread");
+        yarp::sig::Vector o(3, 0.0), sp(3, 0.0);
+        for (size_t k = 0; k < 3; k++)
+        {
+            o[k] = offset.get(k + 1).asDouble();
+            sp[k] = spread.get(k + 1).asDouble();
+        }
+        int count = entry.findGroup("count").get(1).asInt();
+        bool converged = (entry.findGroup("converged").get(1).asInt() != 0);
+        double stamp = entry.findGroup("stamp").get(1).asDouble();
+
+        // results stored without their pose were taken at the calibration pose
+        yarp::os::Bottle &pose = entry.findGroup("pose");
+        yarp::sig::Vector q = getParams()->calibPos[arm.id];
+        if (pose.size() > 1)
+        {
+            q.resize(pose.size() - 1);
+            for (size_t j = 0; j < q.length(); j++)
+            {
+                q[j] = pose.get(j + 1).asDouble();
+            }
+        }
+
+        std::lock_guard<std::mutex> lg(arm.mtx_estimate);
+        arm.filteredOffset = o;
+        arm.countOffset = count;
+        arm.converged = converged;
+        arm.publish(o, sp, stamp, count, converged);
+        arm.prior = arm.getSnapshot();
+        arm.priorPose = q;
+        yInfo() << "Loaded" << arm.name << "offset" << o.toString() << "from" << storeDir;
+    }
+
+    /**********************************************************/
+    bool lookAndCalibrate(const std::string part, const int timeout)
+    {
+        yInfo() << "Trying to look at" << part;
+        if (getArm(part) == NULL)
+        {
+            yError() << "Part not handled" << part;
+            return false;
+        }
+        std::string state = runSync(part, timeout, false);
+        if ((state == "converged") || (state == "completed"))
+        {
+            yInfo() << "Calibrated" << part;
+            return true;
+        }
+        yError() << "Could not calibrate" << part << "(" << state << ")";
+        return false;
+    }
+
+    /**********************************************************/
+    bool lookAndCalibrateBoth(const int timeout)
+    {
+        yInfo() << "Trying to look at both arms";
+        std::string state = runSync("both", timeout, false);
+        if ((state == "converged") || (state == "completed"))
+        {
+            yInfo() << "Calibrated both arms";
+            return true;
+        }
+        yError() << "Could not calibrate both arms" << "(" << state << ")";
+        return false;
+    }
+
+    /**********************************************************/
+    // Runs a job and waits for it, for the synchronous rpcs
+    std::string runSync(const std::string &part, const int timeout, const bool field)
+    {
+        std::shared_ptr<CalibrationJob> job = startJob(part, timeout, field);
+        if (!job)
+        {
+            return "rejected";
+        }
+        return job->wait();
+    }
+
+    /**********************************************************/
+    int startCalibration(const std::string &part, const int timeout)
+    {
+        if (part != "both" && getArm(part) == NULL)
+        {
+            yError() << "Part not handled" << part;
+            return -1;
+        }
+        std::shared_ptr<CalibrationJob> job = startJob(part, timeout, false);
+        return job ? job->id : -1;
+    }
+
+    /**********************************************************/
+    // Starts a job unless another one is running; finished jobs beyond
+    // the last maxJobs are forgotten
+    std::shared_ptr<CalibrationJob> startJob(const std::string &part, const int timeout,
+                                             const bool field)
+    {
+        std::lock_guard<std::mutex> lg(mtx_jobs);
+        if (closing)
+        {
+            return nullptr;
+        }
+        for (auto &it : jobs)
+        {
+            if (it.second->running)
+            {
+                yError() << "Job" << it.first << "is still running";
+                return nullptr;
+            }
+        }
+
+        for (auto &it : jobs)
+        {
+            if (it.second->worker.joinable())
+            {
+                it.second->worker.join();
+            }
+        }
+        while (jobs.size() >= maxJobs)
+        {
+            jobs.erase(jobs.begin());
+        }
+
+        std::shared_ptr<CalibrationJob> job = std::make_shared<CalibrationJob>(nextJob++, part, timeout, field);
+        jobs[job->id] = job;
+        std::atomic_store(&activeJob, job);
+        job->worker = std::thread([this, job]() { runJob(*job); });
+        yInfo() << "Started job" << job->id << (field ? "measuring the field of" : "calibrating") << part;
+        return job;
+    }
+
+    /**********************************************************/
+    bool isCancelled() const
+    {
+        std::shared_ptr<CalibrationJob> job = std::atomic_load(&activeJob);
+        return closing || (job && job->cancelled);
+    }
+
+    /**********************************************************/
+    void stopArms(const CalibrationJob &job)
+    {
+        std::lock_guard<std::mutex> lg(mtx_devices);
+        if (job.part == "both")
+        {
+            robot->stopControl(leftArm.id);
+            robot->stopControl(rightArm.id);
+        }
+        else
+        {
+            robot->stopControl(getArm(job.part)->id);
+        }
+    }
+
+    /**********************************************************/
+    void runJob(CalibrationJob &job)
+    {
+        if (job.field)
+        {
+            bool ok = measureField(job.part, job.timeout);
+            if (job.cancelled)
+            {
+                stopArms(job);
+            }
+            job.setState(job.cancelled ? "cancelled" : (ok ? "completed" : "failed"));
+            yInfo() << "Job" << job.id << job.getState();
+            job.finish();
+            return;
+        }
+
+        bool both = (job.part == "both");
+        bool ok = both ? lookBoth(job.timeout) : look(job.part, job.timeout);
+        if (job.cancelled)
+        {
+            stopArms(job);
+            job.setState("cancelled");
+        }
+        else if (!ok)
+        {
+            job.setState("failed");
+        }
+        else
+        {
+            job.setState("calibrating");
+            ok = both ? calibrateBoth(job.timeout) : calibrate(job.part, job.timeout);
+            if (job.cancelled)
+            {
+                stopArms(job);
+                job.setState("cancelled");
+            }
+            else if (!ok)
+            {
+                job.setState("timeout");
+            }
+            else
+            {
+                bool converged = both ? (leftArm.converged && rightArm.converged) :
+                                        getArm(job.part)->converged.load();
+                if (both)
+                {
+                    saveResult(leftArm);
+                    saveResult(rightArm);
+                }
+                else
+                {
+                    saveResult(*getArm(job.part));
+                }
+                job.setState(converged ? "converged" : "completed");
+            }
+        }
+        yInfo() << "Job" << job.id << job.getState();
+        job.finish();
+    }
+
+    /**********************************************************/
+    CalibrationStatus getStatus(const int id)
+    {
+        CalibrationStatus status;
+        status.job = id;
+        status.accepted = 0;
+        status.rejected = 0;
+
+        std::shared_ptr<CalibrationJob> job;
+        {
+            std::lock_guard<std::mutex> lg(mtx_jobs);
+            auto it = jobs.find(id);
+            if (it == jobs.end())
+            {
+                status.state = "unknown";
+                return status;
+            }
+            job = it->second;
+        }
+        status.part = job->part;
+        status.state = job->getState();
+
+        std::vector<ArmContext*> arms;
+        if (job->part == "both")
+        {
+            arms.push_back(&leftArm);
+            arms.push_back(&rightArm);
+        }
+        else
+        {
+            arms.push_back(getArm(job->part));
+        }
+        for (size_t i = 0; i < arms.size(); i++)
+        {
+            std::lock_guard<std::mutex> lg(arms[i]->mtx_estimate);
+            status.accepted += arms[i]->countOffset;
+            status.rejected += arms[i]->countRejected;
+            const yarp::sig::Vector &spread = arms[i]->estimator->getSpread();
+            for (size_t k = 0; k < 3; k++)
+            {
+                status.estimate.push_back(arms[i]->filteredOffset[k]);
+                status.spread.push_back(spread[k]);
+            }
+        }
+        return status;
+    }
+
+    /**********************************************************/
+    bool cancel(const int id)
+    {
+        std::shared_ptr<CalibrationJob> job;
+        {
+            std::lock_guard<std::mutex> lg(mtx_jobs);
+            auto it = jobs.find(id);
+            if (it == jobs.end() || !it->second->running)
+            {
+                return false;
+            }
+            job = it->second;
+        }
+
+        // the arms are stopped by the job thread, which owns the devices
+        // while it moves them
+        yInfo() << "Cancelling job" << id;
+        job->cancelled = true;
+        if (job->part == "both")
+        {
+            stopCalibrating(leftArm, SessionRecorder::CANCEL);
+            stopCalibrating(rightArm, SessionRecorder::CANCEL);
+        }
+        else
+        {
+            stopCalibrating(*getArm(job->part), SessionRecorder::CANCEL);
+        }
+        return true;
+    }
+
+    /**********************************************************/
+    bool calibrate(const std::string part, const int timeout)
+    {
+        ArmContext *arm = getArm(part);
+        if (arm == NULL)
+        {
+            return false;
+        }
+        yInfo() << "Waiting" << part << "to be calibrated";
+        {
+            std::unique_lock<std::mutex> lck(arm->mtx_calibrated_part);
+            arm->part_calibrated.wait_for(lck,std::chrono::seconds(timeout),
+                                          [arm]() { return !arm->calibrating; });
+        }
+        if (arm->calibrating)
+        {
+            yWarning() << "Timeout expired while calibrating" << part;
+            stopCalibrating(*arm, SessionRecorder::TIMEOUT);
+        }
+        return arm->calibrated;
+    }
+
+    /**********************************************************/
+    bool calibrateBoth(const int timeout)
+    {
+        yInfo() << "Waiting both arms to be calibrated";
+        std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+        ArmContext *fixated = &leftArm;
+        while (leftArm.calibrating || rightArm.calibrating)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                yWarning() << "Timeout expired while calibrating both arms";
+                stopCalibrating(leftArm, SessionRecorder::TIMEOUT);
+                stopCalibrating(rightArm, SessionRecorder::TIMEOUT);
+                break;
+            }
+
+            // in alternate mode wake up every gazeSwitchPeriod to move the gaze
+            ArmContext *waiting = leftArm.calibrating ? &leftArm : &rightArm;
+            std::chrono::steady_clock::time_point until = deadline;
+            if (bimanualGaze == "alternate")
+            {
+                until = std::min(deadline, now + std::chrono::milliseconds((int)(1000.0 * gazeSwitchPeriod)));
+            }
+            {
+                std::unique_lock<std::mutex> lck(waiting->mtx_calibrated_part);
+                waiting->part_calibrated.wait_until(lck, until,
+                                                    [waiting]() { return !waiting->calibrating; });
+            }
+
+            if (bimanualGaze == "alternate")
+            {
+                ArmContext *next = (fixated == &leftArm) ? &rightArm : &leftArm;
+                if (next->calibrating)
+                {
+                    std::lock_guard<std::mutex> lg(mtx_devices);
+                    if (fixateHand(*next, false))
+                    {
+                        fixated = next;
+                    }
+                }
+            }
+        }
+        return leftArm.calibrated && rightArm.calibrated;
+    }
+
+    /**********************************************************/
+    // warmStart seeds the estimator with the stored result, if that was
+    // measured at the pose the arm is sent to
+    void resetArm(ArmContext &arm, const bool warmStart)
+    {
+        std::lock_guard<std::mutex> lg(arm.mtx_estimate);
+        arm.calibrated = false;
+        arm.converged = false;
+        arm.countOffset = 0;
+        arm.countRejected = 0;
+        arm.rawOffsets.clear();
+        arm.estimator->init(getParams()->filterOrder + 1);
+        arm.startPrior.reset();
+
+        if (warmStart && arm.prior && (arm.prior->count > 0) && samePose(arm.priorPose, arm.target))
+        {
+            arm.estimator->setPrior(arm.prior->offset, arm.prior->spread);
+            arm.startPrior = arm.prior;
+        }
+    }
+
+    /**********************************************************/
+    bool samePose(const yarp::sig::Vector &q0, const yarp::sig::Vector &q1) const
+    {
+        if (q0.length() != q1.length())
+        {
+            return false;
+        }
+        for (size_t j = 0; j < q0.length(); j++)
+        {
+            if (std::abs(q0[j] - q1[j]) > motionTol)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**********************************************************/
+    void startCalibrating(ArmContext &arm)
+    {
+        if (recorder.isActive())
+        {
+            yarp::sig::Vector priorOffset, priorSpread;
+            {
+                std::lock_guard<std::mutex> lg(arm.mtx_estimate);
+                if (arm.startPrior)
+                {
+                    priorOffset = arm.startPrior->offset;
+                    priorSpread = arm.startPrior->spread;
+                }
+            }
+            recorder.recordStart(yarp::os::Time::now(), arm.id, priorOffset, priorSpread);
+        }
+        arm.calibrating = true;
+        updateIdle();
+    }
+
+    /**********************************************************/
+    // Ends the collection of an arm, logging why for the replay
+    void stopCalibrating(ArmContext &arm, const SessionRecorder::StopReason reason)
+    {
+        if (arm.calibrating && recorder.isActive())
+        {
+            recorder.recordStop(yarp::os::Time::now(), arm.id, reason);
+        }
+        arm.stopCalibrating();
+        updateIdle();
+    }
+
+    /**********************************************************/
+    void moveArm(ArmContext &arm, const yarp::sig::Vector &qd, const bool warmStart)
+    {
+        arm.target = qd;
+        resetArm(arm, warmStart);
+        for (size_t j=0; j<qd.length(); j++)
+        {
+            robot->setRefSpeed(arm.id,j,homeVels[j]);
+            robot->positionMove(arm.id,j,qd[j]);
+        }
+    }
+
+    /**********************************************************/
+    // Motion state read from the controlboard streamed encoders, so no
+    // checkMotionDone round-trip is needed. An arm is settled once it is
+    // at its target and still; one that has been still for
+    // motionStallTime without reaching it is reported as stalled.
+    bool armSettled(ArmContext &arm, double &stillSince, bool &stalled)
+    {
+        std::vector<double> q(arm.nAxes), dq(arm.nAxes);
+        if (!robot->getEncoders(arm.id, q.data(), dq.data()))
+        {
+            return false;
+        }
+
+        bool atTarget = true;
+        bool still = true;
+        for (size_t j=0; j<arm.target.length() && (int)j<arm.nAxes; j++)
+        {
+            atTarget = atTarget && (std::fabs(q[j] - arm.target[j]) <= motionTol);
+            still = still && (std::fabs(dq[j]) <= motionVelTol);
+        }
+
+        double now = yarp::os::Time::now();
+        if (!still)
+        {
+            stillSince = now;
+        }
+        stalled = still && ((now - stillSince) >= motionStallTime);
+        return (atTarget && still) || stalled;
+    }
+
+    /**********************************************************/
+    void waitArms(ArmContext *first, ArmContext *second, const int timeout)
+    {
+        double t0 = yarp::os::Time::now();
+        double stillFirst = t0, stillSecond = t0;
+        bool doneFirst = false, doneSecond = (second == NULL);
+        bool stalledFirst = false, stalledSecond = false;
+        while (!doneFirst || !doneSecond)
+        {
+            if (!doneFirst)
+            {
+                doneFirst = armSettled(*first, stillFirst, stalledFirst);
+            }
+            if (!doneSecond)
+            {
+                doneSecond = armSettled(*second, stillSecond, stalledSecond);
+            }
+            if ((yarp::os::Time::now() - t0) > timeout)
+            {
+                yWarning() << "Timeout expired";
+                break;
+            }
+            if (isCancelled())
+            {
+                yWarning() << "Motion cancelled";
+                break;
+            }
+            yarp::os::Time::delay(0.01);
+        }
+        if (stalledFirst || stalledSecond)
+        {
+            yWarning() << "Arm stopped before reaching the calibration position";
+        }
+    }
+
+    /**********************************************************/
+    yarp::sig::Vector predictedHand(const ArmContext &arm) const
+    {
+        std::shared_ptr<const CalibParams> p = getParams();
+        yarp::sig::Vector x(3);
+        x[0] = p->calibPose[arm.id][0];
+        x[1] = p->calibPose[arm.id][1];
+        x[2] = p->calibPose[arm.id][2];
+        return x;
+    }
+
+    /**********************************************************/
+    // The gaze has been heading to the predicted hand position while the
+    // arm moved: correct it only if the hand ended up elsewhere
+    bool refineGaze(const yarp::sig::Vector &predicted, const yarp::sig::Vector &actual)
+    {
+        if (predicted.length() < 3)
+        {
+            return fixate(actual, true);
+        }
+        double d = std::sqrt((actual[0] - predicted[0]) * (actual[0] - predicted[0]) +
+                             (actual[1] - predicted[1]) * (actual[1] - predicted[1]) +
+                             (actual[2] - predicted[2]) * (actual[2] - predicted[2]));
+        if (d > gazeRefineTol)
+        {
+            yDebug() << "Hand" << d << "m away from the predicted position, refining gaze";
+            if (!fixate(actual, false))
+            {
+                return false;
+            }
+        }
+        robot->waitGazeDone(5.0);
+        return true;
+    }
+
+    /**********************************************************/
+    bool fixateHand(ArmContext &arm, const bool sync)
+    {
+        yarp::sig::Vector x0,o0;
+        robot->getHandPose(arm.id,x0,o0);
+        return fixate(x0, sync);
+    }
+
+    /**********************************************************/
+    bool fixate(const yarp::sig::Vector &x0, const bool sync)
+    {
+        bool ok = robot->lookAtFixationPoint(x0, sync);
+        if (!ok)
+        {
+            yError() << "Could not fixate" << x0.toString();
+            return false;
+        }
+        if (sync)
+        {
+            robot->waitGazeDone(5.0);
+        }
+        return true;
+    }
+
+    /**********************************************************/
+    bool look(const std::string part, const int timeout)
+    {
+        ArmContext *arm = getArm(part);
+        if (arm == NULL)
+        {
+            yError() << "Part not handled" << part;
+            return false;
+        }
+        if (!prepareArm(*arm))
+        {
+            return false;
+        }
+
+        return lookAt(*arm, getParams()->calibPos[arm->id], predictedHand(*arm), timeout, true);
+    }
+
+    /**********************************************************/
+    // Moves the arm to qd and starts calibrating once the gaze is on the
+    // hand; xp is the expected hand position, if known, used to start
+    // the gaze while the arm is still moving
+    bool lookAt(ArmContext &arm, const yarp::sig::Vector &qd, const yarp::sig::Vector &xp,
+                const int timeout, const bool warmStart)
+    {
+        std::lock_guard<std::mutex> lg(mtx_devices);
+        yInfo() << "Starting looking at" << arm.name;
+        subscribeSkin(true);
+        moveArm(arm, qd, warmStart);
+
+        //if (!icart->goToPoseSync(xd, od))
+        //{
+        //   yError() << part << "arm could not reach" << xd.toString();
+        //  return false;
+        //}
+        //icart->waitMotionDone(0.001, 5.0);
+
+        if (xp.length() >= 3)
+        {
+            fixate(xp, false);
+        }
+
+        waitArms(&arm, NULL, timeout);
+        if (isCancelled())
+        {
+            return false;
+        }
+        yarp::sig::Vector x0,o0;
+        robot->getHandPose(arm.id,x0,o0);
+        if (!refineGaze(xp, x0))
+        {
+            return false;
+        }
+        yInfo() << "Looking at" << arm.name;
+
+        startCalibrating(arm);
+        return true;
+    }
+
+    /**********************************************************/
+    bool lookBoth(const int timeout)
+    {
+        if (!prepareArm(leftArm) || !prepareArm(rightArm))
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lg(mtx_devices);
+        yInfo() << "Starting looking at both arms";
+        subscribeSkin(true);
+        std::shared_ptr<const CalibParams> p = getParams();
+        moveArm(leftArm, p->calibPos[leftArm.id], true);
+        moveArm(rightArm, p->calibPos[rightArm.id], true);
+
+        yarp::sig::Vector xl = predictedHand(leftArm);
+        yarp::sig::Vector xr = predictedHand(rightArm);
+        yarp::sig::Vector xp = xl;
+        if (bimanualGaze != "alternate")
+        {
+            xp[0] = 0.5 * (xl[0] + xr[0]);
+            xp[1] = 0.5 * (xl[1] + xr[1]);
+            xp[2] = 0.5 * (xl[2] + xr[2]);
+        }
+        fixate(xp, false);
+
+        waitArms(&leftArm, &rightArm, timeout);
+        if (isCancelled())
+        {
+            return false;
+        }
+
+        yarp::sig::Vector x0,o0;
+        robot->getHandPose(leftArm.id,x0,o0);
+        if (bimanualGaze != "alternate")
+        {
+            yarp::sig::Vector x1,o1;
+            robot->getHandPose(rightArm.id,x1,o1);
+            x0[0] = 0.5 * (x0[0] + x1[0]);
+            x0[1] = 0.5 * (x0[1] + x1[1]);
+            x0[2] = 0.5 * (x0[2] + x1[2]);
+        }
+        if (!refineGaze(xp, x0))
+        {
+            return false;
+        }
+        yInfo() << "Looking at both arms";
+
+        startCalibrating(leftArm);
+        startCalibrating(rightArm);
+        return true;
+    }
+
+    /**********************************************************/
+    bool home()
+    {
+        std::lock_guard<std::mutex> lg(mtx_devices);
+        yInfo() << "Homing arms and gaze";
+        yarp::sig::Vector xd(3, 0.0);
+        xd[0] = -1.0;
+        xd[2] = 0.3;
+        if (!robot->lookAtFixationPoint(xd, false))
+        {
+            yError() << "Could not fixate" << xd.toString();
+            return false;
+        }
+
+        //for (size_t j=0; j<homeVels.length(); j++)
+        //{
+        //    robot->setPositionMode(leftArm.id,j);
+        //    robot->setPositionMode(rightArm.id,j);
+        //}
+
+        for (size_t j=0; j<homeVels.length(); j++)
+        {
+            //robot->setRefSpeed(leftArm.id,j,homeVels[j]);
+            robot->positionMove(leftArm.id,j,homePos[j]);
+            //robot->setRefSpeed(rightArm.id,j,homeVels[j]);
+            robot->positionMove(rightArm.id,j,homePos[j]);
+        }
+        return true;
+    }
+};
+
+#endif
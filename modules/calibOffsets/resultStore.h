@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_RESULT_STORE_H__
+#define __CALIB_OFFSETS_RESULT_STORE_H__
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Os.h>
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+/********************************************************/
+// Append-only history of the calibration results of one robot: a text
+// file per arm holding one Bottle per line. An entry is appended and
+// synced on its own; a line cut short by a crash is skipped on loading.
+// Past 2 * maxEntries entries the history is compacted to the last
+// maxEntries through a synced temporary file renamed over the old one.
+class ResultStore
+{
+    static const size_t maxEntries = 1000;
+
+    std::string dir;
+    std::string robotName;
+    std::map<std::string, size_t> counts;
+    std::mutex mtx;
+
+    /********************************************************/
+    std::string path(const std::string &part) const
+    {
+        return dir + "/" + robotName + "_" + part + ".log";
+    }
+
+    /********************************************************/
+    static bool read(const std::string &file, std::vector<std::string> &lines)
+    {
+        std::ifstream in(file, std::ios_base::in | std::ios_base::binary);
+        if (!in.is_open())
+        {
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty())
+            {
+                lines.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    /********************************************************/
+    static bool syncFile(FILE *f)
+    {
+        bool ok = (fflush(f) == 0);
+#ifndef _WIN32
+        ok = (fsync(fileno(f)) == 0) && ok;
+#endif
+        return ok;
+    }
+
+    /********************************************************/
+    // Makes a file created or renamed in the directory of file durable
+    static bool syncDir(const std::string &file)
+    {
+#ifndef _WIN32
+        size_t slash = file.rfind('/');
+        std::string dir = (slash == std::string::npos) ? "." : file.substr(0, slash + 1);
+        int fd = ::open(dir.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        bool ok = (fsync(fd) == 0);
+        ::close(fd);
+        return ok;
+#else
+        return true;
+#endif
+    }
+
+    /********************************************************/
+    bool compact(const std::string &part)
+    {
+        std::vector<std::string> lines;
+        if (!read(path(part), lines))
+        {
+            return false;
+        }
+        size_t first = (lines.size() > maxEntries) ? lines.size() - maxEntries : 0;
+        std::string content;
+        for (size_t i = first; i < lines.size(); i++)
+        {
+            content += lines[i] + "\n";
+        }
+        if (!writeAtomically(path(part), content))
+        {
+            return false;
+        }
+        counts[part] = lines.size() - first;
+        return true;
+    }
+
+public:
+
+    /********************************************************/
+    void configure(const std::string &dir, const std::string &robotName)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        this->dir = dir;
+        this->robotName = robotName;
+        counts.clear();
+        yarp::os::mkdir_p(dir.c_str());
+    }
+
+    /********************************************************/
+    // Replaces file with content through a synced temporary file
+    static bool writeAtomically(const std::string &file, const std::string &content)
+    {
+        std::string tmp = file + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "wb");
+        if (f == NULL)
+        {
+            return false;
+        }
+        bool ok = (fwrite(content.data(), 1, content.size(), f) == content.size());
+        ok = syncFile(f) && ok;
+        ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+        std::remove(file.c_str());
+#endif
+        if (!ok || (std::rename(tmp.c_str(), file.c_str()) != 0))
+        {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return syncDir(file);
+    }
+
+    /********************************************************/
+    bool append(const std::string &part, const yarp::os::Bottle &entry)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (dir.empty())
+        {
+            return false;
+        }
+        std::string file = path(part);
+        if (counts.find(part) == counts.end())
+        {
+            std::vector<std::string> lines;
+            read(file, lines);
+            counts[part] = lines.size();
+        }
+
+        FILE *f = fopen(file.c_str(), "a+b");
+        if (f == NULL)
+        {
+            return false;
+        }
+        // a line cut short by a crash is terminated, not continued
+        bool created = (fseek(f, 0, SEEK_END) == 0) && (ftell(f) == 0);
+        std::string line = entry.toString() + "\n";
+        if (!created && (fseek(f, -1, SEEK_END) == 0) && (fgetc(f) != '\n'))
+        {
+            line = "\n" + line;
+        }
+        bool ok = (fseek(f, 0, SEEK_END) == 0);
+        ok = (fwrite(line.data(), 1, line.size(), f) == line.size()) && ok;
+        ok = syncFile(f) && ok;
+        ok = (fclose(f) == 0) && ok;
+        if (ok && created)
+        {
+            ok = syncDir(file);
+        }
+        if (!ok)
+        {
+            return false;
+        }
+
+        if (++counts[part] > 2 * maxEntries)
+        {
+            return compact(part);
+        }
+        return true;
+    }
+
+    /********************************************************/
+    bool loadLatest(const std::string &part, yarp::os::Bottle &entry)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        std::vector<std::string> lines;
+        if (dir.empty() || !read(path(part), lines))
+        {
+            return false;
+        }
+
+        for (size_t i = lines.size(); i > 0; i--)
+        {
+            if (lines[i - 1].back() != ')')
+            {
+                continue;
+            }
+            entry.fromString(lines[i - 1]);
+            if (isValid(entry))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /********************************************************/
+    // An entry is used only if it holds every field of a stored result
+    static bool isValid(const yarp::os::Bottle &entry)
+    {
+        const yarp::os::Bottle &stamp = entry.findGroup("stamp");
+        const yarp::os::Bottle &offset = entry.findGroup("offset");
+        const yarp::os::Bottle &spread = entry.findGroup("spread");
+        const yarp::os::Bottle &count = entry.findGroup("count");
+        const yarp::os::Bottle &converged = entry.findGroup("converged");
+        if ((stamp.size() != 2) || !stamp.get(1).isDouble() ||
+            (offset.size() != 4) || (spread.size() != 4) ||
+            (count.size() != 2) || !count.get(1).isInt() ||
+            (converged.size() != 2) || !converged.get(1).isInt())
+        {
+            return false;
+        }
+        for (size_t k = 1; k < 4; k++)
+        {
+            if (!offset.get(k).isDouble() || !spread.get(k).isDouble())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,959 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_ROBOT_H__
+#define __CALIB_OFFSETS_ROBOT_H__
+
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/PeriodicThread.h>
+#include <yarp/os/Property.h>
+
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/dev/CartesianControl.h>
+#include <yarp/dev/GazeControl.h>
+#include <yarp/dev/IControlMode.h>
+#include <yarp/dev/IPositionControl.h>
+#include <yarp/dev/IEncoders.h>
+#include <yarp/dev/PreciselyTimed.h>
+
+#include <yarp/math/Math.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+/********************************************************/
+// Devices used by the calibration. Arms are addressed by the
+// ArmContext id: 0 for the left arm, 1 for the right one.
+class RobotInterface
+{
+public:
+
+    /********************************************************/
+    virtual ~RobotInterface()
+    {
+    }
+
+    virtual bool open() = 0;
+    virtual bool openArm(const int arm) = 0;
+    virtual bool isArmOpen(const int arm) = 0;
+    virtual void close() = 0;
+    virtual int getAxes(const int arm) = 0;
+    virtual bool setPositionMode(const int arm, const int j) = 0;
+    virtual bool setRefSpeed(const int arm, const int j, const double vel) = 0;
+    virtual bool positionMove(const int arm, const int j, const double ref) = 0;
+    // stops the joints of the arm and the gaze where they are
+    virtual bool stopControl(const int arm) = 0;
+    virtual bool getEncoders(const int arm, double *q, double *dq,
+                             yarp::os::Stamp *stamp = NULL) = 0;
+    virtual bool getHandPose(const int arm, yarp::sig::Vector &x, yarp::sig::Vector &o,
+                             yarp::os::Stamp *stamp = NULL) = 0;
+    virtual bool getEyePose(yarp::sig::Vector &x, yarp::sig::Vector &o,
+                            yarp::os::Stamp *stamp = NULL) = 0;
+    virtual bool lookAtFixationPoint(const yarp::sig::Vector &x, const bool sync) = 0;
+    virtual bool waitGazeDone(const double timeout) = 0;
+    // fastest head joint, i.e. how fast the gaze controller is moving
+    // the neck and the eyes [deg/s]
+    virtual bool getHeadSpeed(double &speed, yarp::os::Stamp *stamp = NULL) = 0;
+};
+
+/********************************************************/
+// The real robot: cartesian and gaze controllers plus the arm and head
+// controlboards. Drivers are opened concurrently, each given at most
+// openTimeout; in lazy mode open() only brings up the gaze and the head,
+// and the devices of an arm are opened by openArm() the first time the
+// arm is needed.
+class YarpRobot : public RobotInterface
+{
+    /********************************************************/
+    struct Device
+    {
+        std::string name;
+        yarp::os::Property options;
+        yarp::dev::PolyDriver driver;
+        std::future<bool> opening;
+        bool ready;
+
+        Device() : ready(false) { }
+    };
+
+    std::string moduleName;
+    std::string robotName;
+    double openTimeout;
+    bool lazy;
+
+    Device cart[2];
+    Device arm[2];
+    Device gaze;
+    Device head;
+    std::mutex mtx_open;
+    std::atomic<bool> armReady[2];
+    yarp::dev::IPositionControl *ipos[2];
+    yarp::dev::IControlMode *imode[2];
+    yarp::dev::IEncoders *ienc[2];
+    yarp::dev::IPreciselyTimed *itime[2];
+    yarp::dev::ICartesianControl *icart[2];
+    yarp::dev::IGazeControl *igaze;
+    yarp::dev::IEncoders *iheadEnc;
+    yarp::dev::IPreciselyTimed *iheadTime;
+    std::vector<double> headSpeeds;
+
+    /********************************************************/
+    static void setup(Device &device, const std::string &name, const std::string &type,
+                      const std::string &remote, const std::string &local)
+    {
+        device.name = name;
+        device.options.put("device", type);
+        device.options.put("remote", remote);
+        device.options.put("local", local);
+    }
+
+    /********************************************************/
+    static void start(Device &device)
+    {
+        if (!device.ready && !device.opening.valid())
+        {
+            Device *d = &device;
+            device.opening = std::async(std::launch::async, [d]() { return d->driver.open(d->options); });
+        }
+    }
+
+    /********************************************************/
+    // A driver still opening at the deadline is left to complete in the
+    // background, a later call picks up its outcome
+    static bool finish(Device &device, const std::chrono::steady_clock::time_point &deadline)
+    {
+        if (device.ready)
+        {
+            return true;
+        }
+        if (!device.opening.valid())
+        {
+            return false;
+        }
+        if (device.opening.wait_until(deadline) != std::future_status::ready)
+        {
+            yError() << "Timed out opening" << device.name;
+            return false;
+        }
+        device.ready = device.opening.get() && device.driver.isValid();
+        if (!device.ready)
+        {
+            yError() << "Could not open" << device.name;
+        }
+        return device.ready;
+    }
+
+    /********************************************************/
+    bool finishArm(const int i, const std::chrono::steady_clock::time_point &deadline)
+    {
+        bool cartOk = finish(cart[i], deadline);
+        bool armOk = finish(arm[i], deadline);
+        if (!cartOk || !armOk)
+        {
+            return false;
+        }
+        arm[i].driver.view(ipos[i]);
+        arm[i].driver.view(imode[i]);
+        arm[i].driver.view(ienc[i]);
+        arm[i].driver.view(itime[i]);
+        cart[i].driver.view(icart[i]);
+        armReady[i] = true;
+        return true;
+    }
+
+    /********************************************************/
+    std::chrono::steady_clock::time_point deadline() const
+    {
+        return std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double>(openTimeout));
+    }
+
+public:
+
+    /********************************************************/
+    YarpRobot(const std::string &moduleName, const std::string &robotName,
+              const std::string &gazeRemote, const double openTimeout, const bool lazy) :
+        moduleName(moduleName), robotName(robotName), openTimeout(openTimeout), lazy(lazy),
+        igaze(NULL), iheadEnc(NULL), iheadTime(NULL)
+    {
+        static const char *parts[2] = {"left_arm", "right_arm"};
+        for (int i = 0; i < 2; i++)
+        {
+            std::string part = parts[i];
+            setup(cart[i], part + " cartesian", "cartesiancontrollerclient",
+                  "/" + robotName + "/cartesianController/" + part, "/" + moduleName + "/cartesian/" + part);
+            setup(arm[i], part + " controlboard", "remote_controlboard",
+                  "/" + robotName + "/" + part, "/" + moduleName + "/" + part);
+            armReady[i] = false;
+            ipos[i] = NULL;
+            imode[i] = NULL;
+            ienc[i] = NULL;
+            itime[i] = NULL;
+            icart[i] = NULL;
+        }
+        setup(gaze, "gaze", "gazecontrollerclient", gazeRemote, "/" + moduleName + "/gaze");
+        setup(head, "head controlboard", "remote_controlboard",
+              "/" + robotName + "/head", "/" + moduleName + "/head");
+    }
+
+    /********************************************************/
+    ~YarpRobot()
+    {
+        close();
+    }
+
+    /********************************************************/
+    bool open() override
+    {
+        std::lock_guard<std::mutex> lg(mtx_open);
+        double t0 = yarp::os::Time::now();
+        start(gaze);
+        start(head);
+        if (!lazy)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                start(cart[i]);
+                start(arm[i]);
+            }
+        }
+
+        std::chrono::steady_clock::time_point until = deadline();
+        bool ok = finish(gaze, until);
+        if (ok)
+        {
+            gaze.driver.view(igaze);
+        }
+        // without the head the gaze motion gate has no data and lets
+        // every sample through
+        if (finish(head, until))
+        {
+            head.driver.view(iheadEnc);
+            head.driver.view(iheadTime);
+        }
+        else
+        {
+            yWarning() << "No head speeds, skin samples are not gated on the gaze motion";
+        }
+        if (!lazy)
+        {
+            bool left = finishArm(0, until);
+            bool right = finishArm(1, until);
+            if (!left && !right)
+            {
+                ok = false;
+            }
+            else if (!left || !right)
+            {
+                yWarning() << "Only the" << (left ? "left" : "right") << "arm is available";
+            }
+        }
+        yInfo() << "Devices opened in" << yarp::os::Time::now() - t0 << "s";
+        return ok;
+    }
+
+    /********************************************************/
+    bool openArm(const int i) override
+    {
+        if (armReady[i])
+        {
+            return true;
+        }
+        std::lock_guard<std::mutex> lg(mtx_open);
+        start(cart[i]);
+        start(arm[i]);
+        return finishArm(i, deadline());
+    }
+
+    /********************************************************/
+    bool isArmOpen(const int i) override
+    {
+        return armReady[i];
+    }
+
+    /********************************************************/
+    void close() override
+    {
+        std::lock_guard<std::mutex> lg(mtx_open);
+        Device *devices[6] = {&cart[0], &cart[1], &arm[0], &arm[1], &gaze, &head};
+        armReady[0] = armReady[1] = false;
+        igaze = NULL;
+        iheadEnc = NULL;
+        iheadTime = NULL;
+        for (int i = 0; i < 6; i++)
+        {
+            // a driver cannot be closed while it is still opening
+            if (devices[i]->opening.valid())
+            {
+                devices[i]->opening.wait();
+            }
+            devices[i]->driver.close();
+            devices[i]->ready = false;
+        }
+    }
+
+    /********************************************************/
+    int getAxes(const int arm) override
+    {
+        int nAxes = 0;
+        if (armReady[arm])
+        {
+            ienc[arm]->getAxes(&nAxes);
+        }
+        return nAxes;
+    }
+
+    /********************************************************/
+    bool setPositionMode(const int arm, const int j) override
+    {
+        return armReady[arm] && imode[arm]->setControlMode(j,VOCAB_CM_POSITION);
+    }
+
+    /********************************************************/
+    bool setRefSpeed(const int arm, const int j, const double vel) override
+    {
+        return armReady[arm] && ipos[arm]->setRefSpeed(j,vel);
+    }
+
+    /********************************************************/
+    bool positionMove(const int arm, const int j, const double ref) override
+    {
+        return armReady[arm] && ipos[arm]->positionMove(j,ref);
+    }
+
+    /********************************************************/
+    bool stopControl(const int arm) override
+    {
+        bool ok = armReady[arm] && ipos[arm]->stop();
+        return (igaze != NULL) && igaze->stopControl() && ok;
+    }
+
+    /********************************************************/
+    // stamped with the envelope of the controlboard state stream
+    bool getEncoders(const int arm, double *q, double *dq, yarp::os::Stamp *stamp) override
+    {
+        if (!armReady[arm] || !ienc[arm]->getEncoders(q) || !ienc[arm]->getEncoderSpeeds(dq))
+        {
+            return false;
+        }
+        if (stamp != NULL)
+        {
+            *stamp = (itime[arm] != NULL) ? itime[arm]->getLastInputStamp() : yarp::os::Stamp();
+        }
+        return true;
+    }
+
+    /********************************************************/
+    bool getHandPose(const int arm, yarp::sig::Vector &x, yarp::sig::Vector &o,
+                     yarp::os::Stamp *stamp) override
+    {
+        return armReady[arm] && icart[arm]->getPose(x,o,stamp);
+    }
+
+    /********************************************************/
+    bool getEyePose(yarp::sig::Vector &x, yarp::sig::Vector &o, yarp::os::Stamp *stamp) override
+    {
+        return (igaze != NULL) && igaze->getLeftEyePose(x,o,stamp);
+    }
+
+    /********************************************************/
+    bool lookAtFixationPoint(const yarp::sig::Vector &x, const bool sync) override
+    {
+        if (igaze == NULL)
+        {
+            return false;
+        }
+        return sync ? igaze->lookAtFixationPointSync(x) : igaze->lookAtFixationPoint(x);
+    }
+
+    /********************************************************/
+    bool waitGazeDone(const double timeout) override
+    {
+        return (igaze != NULL) && igaze->waitMotionDone(0.001, timeout);
+    }
+
+    /********************************************************/
+    // read from the head controlboard state stream and stamped with its
+    // envelope, rather than asking the gaze controller over rpc
+    bool getHeadSpeed(double &speed, yarp::os::Stamp *stamp) override
+    {
+        int nAxes = 0;
+        if ((iheadEnc == NULL) || !iheadEnc->getAxes(&nAxes) || (nAxes <= 0))
+        {
+            return false;
+        }
+        headSpeeds.resize(nAxes);
+        if (!iheadEnc->getEncoderSpeeds(headSpeeds.data()))
+        {
+            return false;
+        }
+        speed = 0.0;
+        for (int j = 0; j < nAxes; j++)
+        {
+            speed = std::max(speed, std::fabs(headSpeeds[j]));
+        }
+        if (stamp != NULL)
+        {
+            *stamp = (iheadTime != NULL) ? iheadTime->getLastInputStamp() : yarp::os::Stamp();
+        }
+        return true;
+    }
+};
+
+/********************************************************/
+// Simulated robot, so that calibration runs headless under a yarpserver.
+// Joints and gaze follow minimum-jerk profiles of fixed duration, the
+// hand sits at the configured calibration pose once the arm is at its
+// calibration position, and whenever an arm rests away from home a ball
+// held at a known offset from its hand is published on synthetic skin
+// and tracker ports connected to the module inputs. The offset grows
+// linearly with the hand distance from the calibration pose, so that
+// the offset field has something to recover.
+class SimRobot : public RobotInterface, public yarp::os::PeriodicThread
+{
+    struct Joint
+    {
+        double q0, qd;
+        double t0;
+    };
+
+    std::string moduleName;
+    double motionTime;
+    double gazeTime;
+    double encoderNoise;
+    double poseNoise;
+    double trackerNoise;
+    double fov;
+    double pressure;
+    double offsetGradient;
+    int nAxes;
+
+    std::vector<Joint> joints[2];
+    yarp::sig::Vector calibPose[2];
+    yarp::sig::Vector calibPos[2];
+    yarp::sig::Vector homePos;
+    yarp::sig::Vector trueOffset[2];
+    yarp::sig::Vector eyePos;
+    yarp::sig::Vector fix0, fixd;
+    double tFix;
+    int nextArm;
+    int pendingArm;
+    yarp::os::Stamp pendingStamp;
+
+    std::mt19937 gen;
+    std::mutex mtx;
+
+    yarp::os::BufferedPort<yarp::os::Bottle> skinPort;
+    yarp::os::BufferedPort<yarp::os::Bottle> trackerPort;
+
+    /********************************************************/
+    static double minJerk(const double tau)
+    {
+        return tau * tau * tau * (10.0 - 15.0 * tau + 6.0 * tau * tau);
+    }
+
+    /********************************************************/
+    static double minJerkVel(const double tau)
+    {
+        return 30.0 * tau * tau * (1.0 - tau) * (1.0 - tau);
+    }
+
+    /********************************************************/
+    static yarp::sig::Vector toVector(const yarp::os::Bottle *b, const size_t n, const double def)
+    {
+        yarp::sig::Vector v(n, def);
+        for (size_t i = 0; (b != NULL) && (i < n) && (i < b->size()); i++)
+        {
+            v[i] = b->get(i).asDouble();
+        }
+        return v;
+    }
+
+    /********************************************************/
+    double noise(const double sigma)
+    {
+        std::normal_distribution<double> n(0.0, sigma);
+        return (sigma > 0.0) ? n(gen) : 0.0;
+    }
+
+    /********************************************************/
+    double jointPos(const Joint &jnt, const double t, double *vel = NULL) const
+    {
+        double tau = std::min(1.0, std::max(0.0, (t - jnt.t0) / motionTime));
+        if (vel != NULL)
+        {
+            *vel = (tau < 1.0) ? (jnt.qd - jnt.q0) * minJerkVel(tau) / motionTime : 0.0;
+        }
+        return jnt.q0 + (jnt.qd - jnt.q0) * minJerk(tau);
+    }
+
+    /********************************************************/
+    // Hand position: the calibration pose, displaced linearly by the
+    // shoulder and elbow joints away from the calibration position [m/deg]
+    yarp::sig::Vector hand(const int arm, const double t) const
+    {
+        static const double J[3][4] = {{ 0.0025, 0.0,   0.0015,  0.003},
+                                       { 0.0,    0.005, 0.001,   0.0},
+                                       {-0.005,  0.0,   0.0,    -0.0025}};
+        yarp::sig::Vector x = calibPose[arm].subVector(0, 2);
+        for (int j = 0; j < 4 && j < nAxes && j < (int)calibPos[arm].length(); j++)
+        {
+            double dq = jointPos(joints[arm][j], t) - calibPos[arm][j];
+            for (int i = 0; i < 3; i++)
+            {
+                x[i] += J[i][j] * dq;
+            }
+        }
+        return x;
+    }
+
+    /********************************************************/
+    yarp::sig::Vector ballOffset(const int arm, const yarp::sig::Vector &xHand) const
+    {
+        yarp::sig::Vector d = xHand - calibPose[arm].subVector(0, 2);
+        return trueOffset[arm] + offsetGradient * d;
+    }
+
+    /********************************************************/
+    // The ball is in the hand of an arm still away from home
+    bool touching(const int arm, const double t) const
+    {
+        bool home = true;
+        for (size_t j = 0; j < joints[arm].size(); j++)
+        {
+            if (t - joints[arm][j].t0 < motionTime)
+            {
+                return false;
+            }
+            home = home && (std::fabs(joints[arm][j].qd - homePos[j]) <= 1.0);
+        }
+        return !home;
+    }
+
+    /********************************************************/
+    yarp::sig::Vector fixation(const double t) const
+    {
+        double s = minJerk(std::min(1.0, std::max(0.0, (t - tFix) / gazeTime)));
+        return fix0 + s * (fixd - fix0);
+    }
+
+    /********************************************************/
+    // Left eye frame with the z axis through the fixation point
+    yarp::sig::Matrix eyeFrame(const double t) const
+    {
+        yarp::sig::Vector z = fixation(t) - eyePos;
+        z = z / yarp::math::norm(z);
+        yarp::sig::Vector x(3);
+        x[0] = -z[1];
+        x[1] = z[0];
+        x[2] = 0.0;
+        x = x / yarp::math::norm(x);
+        yarp::sig::Vector y(3);
+        y[0] = z[1] * x[2] - z[2] * x[1];
+        y[1] = z[2] * x[0] - z[0] * x[2];
+        y[2] = z[0] * x[1] - z[1] * x[0];
+
+        yarp::sig::Matrix H = yarp::math::eye(4, 4);
+        H.setSubcol(x, 0, 0);
+        H.setSubcol(y, 0, 1);
+        H.setSubcol(z, 0, 2);
+        H.setSubcol(eyePos, 0, 3);
+        return H;
+    }
+
+    /********************************************************/
+    // One skinManager contact on the palm of the arm
+    void makeContact(const int arm, yarp::os::Bottle &event)
+    {
+        static const int skinIds[2][3] = {{3, 6, 1}, {4, 6, 4}};
+        static const int palm[] = {126, 127, 129, 102, 103, 104};
+
+        event.clear();
+        yarp::os::Bottle &contact = event.addList();
+        yarp::os::Bottle &id = contact.addList();
+        id.addInt(0);
+        id.addInt(skinIds[arm][0]);
+        id.addInt(skinIds[arm][1]);
+        id.addInt(skinIds[arm][2]);
+
+        // centre of pressure, force, moment, geometric centre, normal
+        for (int k = 0; k < 5; k++)
+        {
+            yarp::os::Bottle &v = contact.addList();
+            v.addDouble(0.0);
+            v.addDouble(0.0);
+            v.addDouble((k == 4) ? 1.0 : 0.0);
+        }
+
+        yarp::os::Bottle &active = contact.addList();
+        for (size_t i = 0; i < sizeof(palm) / sizeof(palm[0]); i++)
+        {
+            active.addInt(palm[i]);
+        }
+        contact.addDouble(pressure + noise(0.1 * pressure));
+    }
+
+    /********************************************************/
+    // Publishes the ball held by one of the touching hands, alternating
+    // between them. The matching palm contact carries the same stamp and
+    // goes out one period later, so that it never reaches the module
+    // before its tracker sample.
+    void run() override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (pendingArm >= 0)
+        {
+            makeContact(pendingArm, skinPort.prepare());
+            skinPort.setEnvelope(pendingStamp);
+            skinPort.write();
+            pendingArm = -1;
+        }
+
+        double t = yarp::os::Time::now();
+        int arm = -1;
+        for (int k = 0; k < 2 && arm < 0; k++)
+        {
+            if (touching((nextArm + k) % 2, t))
+            {
+                arm = (nextArm + k) % 2;
+            }
+        }
+        if (arm < 0)
+        {
+            return;
+        }
+        nextArm = (arm + 1) % 2;
+
+        yarp::sig::Vector xHand = hand(arm, t);
+        yarp::sig::Vector ball = xHand - ballOffset(arm, xHand);
+        yarp::sig::Vector ballRoot(4, 1.0);
+        ballRoot.setSubvector(0, ball);
+        yarp::sig::Vector ballEye = yarp::math::SE3inv(eyeFrame(t)) * ballRoot;
+        double angle = std::atan2(std::sqrt(ballEye[0] * ballEye[0] + ballEye[1] * ballEye[1]), ballEye[2]);
+        double likelihood = (angle < fov * M_PI / 180.0) ? 0.01 : 0.0;
+
+        yarp::os::Stamp stamp(0, t);
+        yarp::os::Bottle &tracker = trackerPort.prepare();
+        tracker.clear();
+        tracker.addDouble(ballEye[0] + noise(trackerNoise));
+        tracker.addDouble(ballEye[1] + noise(trackerNoise));
+        tracker.addDouble(ballEye[2] + noise(trackerNoise));
+        tracker.addDouble(likelihood);
+        trackerPort.setEnvelope(stamp);
+        trackerPort.write();
+
+        pendingArm = arm;
+        pendingStamp = stamp;
+    }
+
+public:
+
+    /********************************************************/
+    SimRobot(const std::string &moduleName, const double period, const double motionTime,
+             const double gazeTime, const double encoderNoise, const double poseNoise,
+             const double trackerNoise, const double fov, const double pressure,
+             const double offsetGradient,
+             const yarp::sig::Vector &homePos, const yarp::sig::Vector &calibLeft,
+             const yarp::sig::Vector &calibRight, const yarp::sig::Vector &calibLeftPosition,
+             const yarp::sig::Vector &calibRightPosition, const yarp::sig::Vector &offsetLeft,
+             const yarp::sig::Vector &offsetRight, const int seed) :
+        yarp::os::PeriodicThread(period), moduleName(moduleName), motionTime(motionTime),
+        gazeTime(gazeTime), encoderNoise(encoderNoise), poseNoise(poseNoise),
+        trackerNoise(trackerNoise), fov(fov), pressure(pressure), offsetGradient(offsetGradient),
+        nAxes((int)homePos.length()), homePos(homePos),
+        eyePos(3, 0.0), fix0(3, 0.0), fixd(3, 0.0), tFix(0.0), nextArm(0), pendingArm(-1), gen(seed)
+    {
+        calibPose[0] = calibLeft;
+        calibPose[1] = calibRight;
+        calibPos[0] = calibLeftPosition;
+        calibPos[1] = calibRightPosition;
+        trueOffset[0] = offsetLeft;
+        trueOffset[1] = offsetRight;
+        for (int arm = 0; arm < 2; arm++)
+        {
+            joints[arm].resize(nAxes);
+            for (int j = 0; j < nAxes; j++)
+            {
+                joints[arm][j].q0 = joints[arm][j].qd = homePos[j];
+                joints[arm][j].t0 = 0.0;
+            }
+        }
+
+        // left eye of the iCub in the root frame, looking straight ahead
+        eyePos[1] = -0.034;
+        eyePos[2] = 0.34;
+        fix0 = eyePos;
+        fix0[0] = -1.0;
+        fixd = fix0;
+    }
+
+    /********************************************************/
+    static SimRobot *create(const std::string &moduleName, const yarp::os::Searchable &config)
+    {
+        yarp::os::Bottle &sim = config.findGroup("simulation");
+
+        double period = sim.check("period", yarp::os::Value(0.02), "period of the synthetic skin and tracker streams [s]").asDouble();
+        double motionTime = sim.check("motionTime", yarp::os::Value(2.0), "duration of every joint motion [s]").asDouble();
+        double gazeTime = sim.check("gazeTime", yarp::os::Value(0.5), "duration of every gaze shift [s]").asDouble();
+        double encoderNoise = sim.check("encoderNoise", yarp::os::Value(0.05), "std of the encoder noise [deg, deg/s]").asDouble();
+        double poseNoise = sim.check("poseNoise", yarp::os::Value(0.0005), "std of the hand position noise [m]").asDouble();
+        double trackerNoise = sim.check("trackerNoise", yarp::os::Value(0.003), "std of the tracker noise [m]").asDouble();
+        double fov = sim.check("fov", yarp::os::Value(20.0), "half field of view in which the ball is tracked [deg]").asDouble();
+        double pressure = sim.check("pressure", yarp::os::Value(30.0), "average pressure of the palm contacts").asDouble();
+        double offsetGradient = sim.check("offsetGradient", yarp::os::Value(0.05), "change of the true offset per metre of hand displacement").asDouble();
+        int seed = sim.check("seed", yarp::os::Value(0), "seed of the noise generator").asInt();
+
+        yarp::os::Bottle *offsetLeft = sim.find("offsetLeft").asList();
+        yarp::os::Bottle *offsetRight = sim.find("offsetRight").asList();
+        yarp::sig::Vector trueLeft = toVector(offsetLeft, 3, 0.0);
+        yarp::sig::Vector trueRight = toVector(offsetRight, 3, 0.0);
+        if (offsetLeft == NULL)
+        {
+            trueLeft[0] = 0.02;
+            trueLeft[1] = -0.01;
+            trueLeft[2] = 0.015;
+        }
+        if (offsetRight == NULL)
+        {
+            trueRight[0] = 0.02;
+            trueRight[1] = 0.01;
+            trueRight[2] = 0.015;
+        }
+
+        yarp::sig::Vector homePos = toVector(config.find("homePos").asList(), 9, 0.0);
+        yarp::sig::Vector calibLeft = toVector(config.find("calibLeft").asList(), 7, 0.0);
+        yarp::sig::Vector calibRight = toVector(config.find("calibRight").asList(), 7, 0.0);
+        yarp::sig::Vector calibLeftPosition = toVector(config.find("calibLeftPosition").asList(), 9, 0.0);
+        yarp::sig::Vector calibRightPosition = toVector(config.find("calibRightPosition").asList(), 9, 0.0);
+
+        return new SimRobot(moduleName, period, motionTime, gazeTime, encoderNoise, poseNoise,
+                            trackerNoise, fov, pressure, offsetGradient, homePos, calibLeft, calibRight,
+                            calibLeftPosition, calibRightPosition, trueLeft, trueRight, seed);
+    }
+
+    /********************************************************/
+    bool open() override
+    {
+        std::string skinName = "/" + moduleName + "/sim/skin_events:o";
+        std::string trackerName = "/" + moduleName + "/sim/tracker:o";
+        if (!skinPort.open(skinName) || !trackerPort.open(trackerName))
+        {
+            yError() << "Could not open the simulated skin / tracker ports";
+            return false;
+        }
+        if (!yarp::os::Network::connect(skinName, "/" + moduleName + "/handSkin:i") ||
+            !yarp::os::Network::connect(trackerName, "/" + moduleName + "/tracker:i"))
+        {
+            yError() << "Could not connect the simulated skin / tracker ports";
+            return false;
+        }
+        yInfo() << "Simulated robot: motion" << motionTime << "s, gaze" << gazeTime << "s";
+        return start();
+    }
+
+    /********************************************************/
+    void close() override
+    {
+        if (isRunning())
+        {
+            stop();
+        }
+        skinPort.close();
+        trackerPort.close();
+    }
+
+    /********************************************************/
+    bool openArm(const int arm) override
+    {
+        return true;
+    }
+
+    /********************************************************/
+    bool isArmOpen(const int arm) override
+    {
+        return true;
+    }
+
+    /********************************************************/
+    int getAxes(const int arm) override
+    {
+        return nAxes;
+    }
+
+    /********************************************************/
+    bool setPositionMode(const int arm, const int j) override
+    {
+        return (j >= 0) && (j < nAxes);
+    }
+
+    /********************************************************/
+    bool setRefSpeed(const int arm, const int j, const double vel) override
+    {
+        // motions last motionTime whatever the speed
+        return (j >= 0) && (j < nAxes);
+    }
+
+    /********************************************************/
+    bool positionMove(const int arm, const int j, const double ref) override
+    {
+        if ((j < 0) || (j >= nAxes))
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        Joint &jnt = joints[arm][j];
+        jnt.q0 = jointPos(jnt, t);
+        jnt.qd = ref;
+        jnt.t0 = t;
+        return true;
+    }
+
+    /********************************************************/
+    bool stopControl(const int arm) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        for (int j = 0; j < nAxes; j++)
+        {
+            Joint &jnt = joints[arm][j];
+            jnt.q0 = jnt.qd = jointPos(jnt, t);
+            jnt.t0 = t;
+        }
+        fix0 = fixd = fixation(t);
+        tFix = t - gazeTime;
+        return true;
+    }
+
+    /********************************************************/
+    bool getEncoders(const int arm, double *q, double *dq, yarp::os::Stamp *stamp) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        for (int j = 0; j < nAxes; j++)
+        {
+            q[j] = jointPos(joints[arm][j], t, &dq[j]) + noise(encoderNoise);
+            dq[j] += noise(encoderNoise);
+        }
+        if (stamp != NULL)
+        {
+            *stamp = yarp::os::Stamp(0, t);
+        }
+        return true;
+    }
+
+    /********************************************************/
+    bool getHandPose(const int arm, yarp::sig::Vector &x, yarp::sig::Vector &o,
+                     yarp::os::Stamp *stamp) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        x = hand(arm, t);
+        for (int i = 0; i < 3; i++)
+        {
+            x[i] += noise(poseNoise);
+        }
+        o = calibPose[arm].subVector(3, 6);
+        if (stamp != NULL)
+        {
+            *stamp = yarp::os::Stamp(0, t);
+        }
+        return true;
+    }
+
+    /********************************************************/
+    bool getEyePose(yarp::sig::Vector &x, yarp::sig::Vector &o, yarp::os::Stamp *stamp) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        yarp::sig::Matrix H = eyeFrame(t);
+        x = eyePos;
+        o = yarp::math::dcm2axis(H);
+        if (stamp != NULL)
+        {
+            *stamp = yarp::os::Stamp(0, t);
+        }
+        return true;
+    }
+
+    /********************************************************/
+    bool lookAtFixationPoint(const yarp::sig::Vector &x, const bool sync) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        fix0 = fixation(t);
+        fixd = x.subVector(0, 2);
+        tFix = t;
+        return true;
+    }
+
+    /********************************************************/
+    bool waitGazeDone(const double timeout) override
+    {
+        double t0 = yarp::os::Time::now();
+        while (true)
+        {
+            double t = yarp::os::Time::now();
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                if (t - tFix >= gazeTime)
+                {
+                    return true;
+                }
+            }
+            if (t - t0 > timeout)
+            {
+                return false;
+            }
+            yarp::os::Time::delay(0.001);
+        }
+    }
+
+    /********************************************************/
+    // angular speed of the line of sight while the fixation point moves
+    bool getHeadSpeed(double &speed, yarp::os::Stamp *stamp) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        double t = yarp::os::Time::now();
+        double tau = (t - tFix) / gazeTime;
+        speed = 0.0;
+        if (tau < 1.0)
+        {
+            double v = yarp::math::norm(fixd - fix0) * minJerkVel(tau) / gazeTime;
+            speed = (180.0 / M_PI) * v / yarp::math::norm(fixation(t) - eyePos);
+        }
+        if (stamp != NULL)
+        {
+            *stamp = yarp::os::Stamp(0, t);
+        }
+        return true;
+    }
+};
+
+#endif
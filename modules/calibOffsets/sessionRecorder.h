@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_SESSION_RECORDER_H__
+#define __CALIB_OFFSETS_SESSION_RECORDER_H__
+
+#include <yarp/os/Bottle.h>
+
+#include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "skinEvent.h"
+
+/********************************************************/
+// Binary, timestamped log of everything the skin callback consumes: a
+// header followed by records made of type, stamp, payload size and
+// payload, all in host byte order.
+class SessionRecorder
+{
+    std::ofstream out;
+    std::mutex mtx;
+    std::atomic<bool> active;
+    yarp::os::Bottle skinBuffer;
+
+    /********************************************************/
+    void write(const uint8_t type, const double t, const void *data, const uint32_t size)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (!out.is_open())
+        {
+            return;
+        }
+        out.write((const char*)&type, sizeof(type));
+        out.write((const char*)&t, sizeof(t));
+        out.write((const char*)&size, sizeof(size));
+        out.write((const char*)data, size);
+    }
+
+public:
+
+    enum Record { SKIN = 1, TRACKER = 2, EYE = 3, HAND = 4, START = 5, STOP = 6,
+                  JOINT_SPEED = 7, HEAD_SPEED = 8 };
+    enum StopReason { CANCEL = 1, TIMEOUT = 2 };
+    static const uint32_t version = 1;
+
+    /********************************************************/
+    static const char *magic()
+    {
+        return "CALIBOFS";
+    }
+
+    /********************************************************/
+    SessionRecorder() : active(false)
+    {
+    }
+
+    /********************************************************/
+    bool open(const std::string &file)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (out.is_open())
+        {
+            out.close();
+        }
+        out.open(file, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!out.is_open())
+        {
+            active = false;
+            return false;
+        }
+        out.write(magic(), strlen(magic()));
+        out.write((const char*)&version, sizeof(version));
+        active = true;
+        return true;
+    }
+
+    /********************************************************/
+    void close()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        active = false;
+        if (out.is_open())
+        {
+            out.close();
+        }
+    }
+
+    /********************************************************/
+    bool isActive() const
+    {
+        return active;
+    }
+
+    /********************************************************/
+    void recordSkin(const double t, const SkinEvent &skin)
+    {
+        skin.toBottle(skinBuffer);
+        size_t size = 0;
+        const char *data = skinBuffer.toBinary(&size);
+        write(SKIN, t, data, (uint32_t)size);
+    }
+
+    /********************************************************/
+    void recordTracker(const double t, const double x, const double y, const double z,
+                       const double likelihood)
+    {
+        double data[4] = {x, y, z, likelihood};
+        write(TRACKER, t, data, sizeof(data));
+    }
+
+    /********************************************************/
+    void recordEye(const double t, const yarp::sig::Matrix &eye2root)
+    {
+        double data[16];
+        for (size_t r = 0; r < 4; r++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                data[4*r + c] = eye2root(r, c);
+            }
+        }
+        write(EYE, t, data, sizeof(data));
+    }
+
+    /********************************************************/
+    void recordHand(const double t, const int arm, const yarp::sig::Vector &x)
+    {
+        double data[4] = {(double)arm, x[0], x[1], x[2]};
+        write(HAND, t, data, sizeof(data));
+    }
+
+    /********************************************************/
+    void recordJointSpeed(const double t, const int arm, const double speed)
+    {
+        double data[2] = {(double)arm, speed};
+        write(JOINT_SPEED, t, data, sizeof(data));
+    }
+
+    /********************************************************/
+    void recordHeadSpeed(const double t, const double speed)
+    {
+        write(HEAD_SPEED, t, &speed, sizeof(speed));
+    }
+
+    /********************************************************/
+    // The prior the estimator starts from follows the arm, none for a
+    // cold start
+    void recordStart(const double t, const int arm, const yarp::sig::Vector &priorOffset,
+                     const yarp::sig::Vector &priorSpread)
+    {
+        double data[7] = {(double)arm};
+        uint32_t size = sizeof(double);
+        if ((priorOffset.length() == 3) && (priorSpread.length() == 3))
+        {
+            for (size_t k = 0; k < 3; k++)
+            {
+                data[1 + k] = priorOffset[k];
+                data[4 + k] = priorSpread[k];
+            }
+            size = sizeof(data);
+        }
+        write(START, t, data, size);
+    }
+
+    /********************************************************/
+    void recordStop(const double t, const int arm, const StopReason reason)
+    {
+        double data[2] = {(double)arm, (double)reason};
+        write(STOP, t, data, sizeof(data));
+    }
+};
+
+/********************************************************/
+class SessionReader
+{
+    std::ifstream in;
+
+public:
+
+    /********************************************************/
+    bool open(const std::string &file)
+    {
+        in.open(file, std::ios_base::in | std::ios_base::binary);
+        if (!in.is_open())
+        {
+            return false;
+        }
+
+        std::string magic(strlen(SessionRecorder::magic()), '\0');
+        uint32_t version = 0;
+        in.read(&magic[0], magic.size());
+        in.read((char*)&version, sizeof(version));
+        return in.good() && (magic == SessionRecorder::magic()) &&
+               (version == SessionRecorder::version);
+    }
+
+    /********************************************************/
+    bool next(uint8_t &type, double &t, std::vector<char> &payload)
+    {
+        uint32_t size = 0;
+        in.read((char*)&type, sizeof(type));
+        in.read((char*)&t, sizeof(t));
+        in.read((char*)&size, sizeof(size));
+        if (!in.good())
+        {
+            return false;
+        }
+        payload.resize(size);
+        in.read(payload.data(), size);
+        return (size == 0) || (in.gcount() == (std::streamsize)size);
+    }
+};
+
+#endif
@@ -0,0 +1,518 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_SKIN_EVENT_H__
+#define __CALIB_OFFSETS_SKIN_EVENT_H__
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Portable.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/********************************************************/
+// A skinManager skin_events:o message decoded straight from the wire:
+// for every contact the ids of the body part, the average pressure and
+// the active taxels, the only fields the calibration uses. Buffers keep
+// their capacity, so once they fit the largest event seen reading an
+// event allocates nothing. Text-mode connections go through a Bottle.
+class SkinEvent : public yarp::os::Portable
+{
+public:
+
+    struct Contact
+    {
+        int ids[4];
+        int nIds;
+        double pressure;
+        size_t taxelsBegin;
+        size_t taxelsCount;
+    };
+
+private:
+
+    // contact fields: ids, centre of pressure, force, moment, geometric
+    // centre, normal, active taxels, average pressure
+    enum { FIELD_IDS = 0, FIELD_TAXELS = 6, FIELD_PRESSURE = 7 };
+
+    // largest list or string accepted, a count above it means the
+    // message is corrupt rather than a large event
+    enum { MAX_COUNT = 1024 };
+
+    std::vector<Contact> contacts;
+    size_t nContacts;
+    std::vector<int> taxelIds;
+    size_t nTaxels;
+    yarp::os::Bottle text;
+    std::chrono::steady_clock::duration decodeTime;
+    std::shared_ptr<const std::atomic<bool> > idle;
+    bool skipped;
+
+    /********************************************************/
+    // Bounds-checked reader over a binary Bottle in memory, with the
+    // ConnectionReader methods the decoder needs
+    class BufferReader
+    {
+        const char *data;
+        size_t size;
+        size_t pos;
+        bool error;
+
+        /********************************************************/
+        template <class T>
+        T expect()
+        {
+            T value = 0;
+            if (!expectBlock(reinterpret_cast<char*>(&value), sizeof(T)))
+            {
+                return 0;
+            }
+            return value;
+        }
+
+    public:
+
+        /********************************************************/
+        BufferReader(const char *data, const size_t size) : data(data), size(size), pos(0), error(false)
+        {
+        }
+
+        bool expectBlock(char *dst, const size_t n)
+        {
+            if (error || (n > size - pos))
+            {
+                error = true;
+                return false;
+            }
+            std::memcpy(dst, data + pos, n);
+            pos += n;
+            return true;
+        }
+
+        std::int8_t expectInt8() { return expect<std::int8_t>(); }
+        std::int16_t expectInt16() { return expect<std::int16_t>(); }
+        std::int32_t expectInt32() { return expect<std::int32_t>(); }
+        std::int64_t expectInt64() { return expect<std::int64_t>(); }
+        float expectFloat32() { return expect<float>(); }
+        double expectFloat64() { return expect<double>(); }
+        size_t getSize() const { return size; }
+        bool isError() const { return error; }
+    };
+
+    /********************************************************/
+    template <class Reader>
+    static bool readCount(Reader &in, size_t &n)
+    {
+        std::int32_t count = in.expectInt32();
+        if (in.isError() || (count < 0) || (count > MAX_COUNT) || ((size_t)count > in.getSize()))
+        {
+            return false;
+        }
+        n = (size_t)count;
+        return true;
+    }
+
+    /********************************************************/
+    // Reads a numeric item of the given tag, false for any other item
+    template <class Reader>
+    static bool readNumber(Reader &in, const int tag, double &x)
+    {
+        switch (tag)
+        {
+        case BOTTLE_TAG_INT32:
+        case BOTTLE_TAG_VOCAB:
+            x = in.expectInt32();
+            break;
+        case BOTTLE_TAG_INT64:
+            x = (double)in.expectInt64();
+            break;
+        case BOTTLE_TAG_INT8:
+            x = in.expectInt8();
+            break;
+        case BOTTLE_TAG_INT16:
+            x = in.expectInt16();
+            break;
+        case BOTTLE_TAG_FLOAT32:
+            x = in.expectFloat32();
+            break;
+        case BOTTLE_TAG_FLOAT64:
+            x = in.expectFloat64();
+            break;
+        default:
+            return false;
+        }
+        return !in.isError();
+    }
+
+    /********************************************************/
+    template <class Reader>
+    static bool skip(Reader &in, const int tag)
+    {
+        if (tag & BOTTLE_TAG_LIST)
+        {
+            int spec = tag & ~BOTTLE_TAG_LIST;
+            size_t n;
+            if (!readCount(in, n))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                if (!skip(in, spec ? spec : in.expectInt32()))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if ((tag == BOTTLE_TAG_STRING) || (tag == BOTTLE_TAG_BLOB))
+        {
+            size_t n;
+            if (!readCount(in, n))
+            {
+                return false;
+            }
+            char chunk[64];
+            while (n > 0)
+            {
+                size_t len = std::min(n, sizeof(chunk));
+                if (!in.expectBlock(chunk, len))
+                {
+                    return false;
+                }
+                n -= len;
+            }
+            return true;
+        }
+        double x;
+        return readNumber(in, tag, x);
+    }
+
+    /********************************************************/
+    // Reads a list of numbers, keeping at most max of them in dst
+    template <class Reader, class T>
+    static bool readList(Reader &in, const int tag, T *dst, const size_t max, size_t &count)
+    {
+        if (!(tag & BOTTLE_TAG_LIST))
+        {
+            return false;
+        }
+        int spec = tag & ~BOTTLE_TAG_LIST;
+        size_t n;
+        if (!readCount(in, n))
+        {
+            return false;
+        }
+        count = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double x;
+            if (!readNumber(in, spec ? spec : in.expectInt32(), x))
+            {
+                return false;
+            }
+            if (count < max)
+            {
+                dst[count++] = (T)x;
+            }
+        }
+        return true;
+    }
+
+    /********************************************************/
+    template <class Reader>
+    bool readContact(Reader &in, const int tag)
+    {
+        int spec = tag & ~BOTTLE_TAG_LIST;
+        size_t n;
+        if (!readCount(in, n))
+        {
+            return false;
+        }
+
+        Contact &c = addContact();
+        for (size_t k = 0; k < n; k++)
+        {
+            int itemTag = spec ? spec : in.expectInt32();
+            if (k == FIELD_IDS)
+            {
+                size_t nIds;
+                if (!readList(in, itemTag, c.ids, 4, nIds))
+                {
+                    return false;
+                }
+                c.nIds = (int)nIds;
+            }
+            else if ((k == FIELD_TAXELS) && (itemTag & BOTTLE_TAG_LIST))
+            {
+                // taxel ids go straight into the shared buffer
+                int taxelSpec = itemTag & ~BOTTLE_TAG_LIST;
+                size_t nIds;
+                if (!readCount(in, nIds))
+                {
+                    return false;
+                }
+                reserveTaxels(nIds);
+                for (size_t i = 0; i < nIds; i++)
+                {
+                    double x;
+                    if (!readNumber(in, taxelSpec ? taxelSpec : in.expectInt32(), x))
+                    {
+                        return false;
+                    }
+                    taxelIds[nTaxels++] = (int)x;
+                }
+                c.taxelsCount = nIds;
+            }
+            else if (k == FIELD_PRESSURE)
+            {
+                if (!readNumber(in, itemTag, c.pressure))
+                {
+                    return false;
+                }
+            }
+            else if (!skip(in, itemTag))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /********************************************************/
+    template <class Reader>
+    bool parse(Reader &in)
+    {
+        clear();
+        int tag = in.expectInt32();
+        if (in.isError() || !(tag & BOTTLE_TAG_LIST))
+        {
+            return false;
+        }
+        int spec = tag & ~BOTTLE_TAG_LIST;
+        size_t n;
+        if (!readCount(in, n))
+        {
+            return false;
+        }
+        for (size_t j = 0; j < n; j++)
+        {
+            int itemTag = spec ? spec : in.expectInt32();
+            bool ok = (itemTag & BOTTLE_TAG_LIST) ? readContact(in, itemTag) : skip(in, itemTag);
+            if (!ok)
+            {
+                clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /********************************************************/
+    Contact &addContact()
+    {
+        if (nContacts == contacts.size())
+        {
+            contacts.resize(std::max((size_t)8, 2 * contacts.size()));
+        }
+        Contact &c = contacts[nContacts++];
+        c.nIds = 0;
+        c.pressure = 0.0;
+        c.taxelsBegin = nTaxels;
+        c.taxelsCount = 0;
+        return c;
+    }
+
+    /********************************************************/
+    void reserveTaxels(const size_t n)
+    {
+        if (nTaxels + n > taxelIds.size())
+        {
+            taxelIds.resize(std::max(nTaxels + n, 2 * taxelIds.size()));
+        }
+    }
+
+public:
+
+    /********************************************************/
+    SkinEvent() : nContacts(0), nTaxels(0), decodeTime(0), skipped(false)
+    {
+    }
+
+    /********************************************************/
+    // While the flag is set the payload is left unread, the connection
+    // discards it; the port creates the events, so the reader hands the
+    // flag to each of them
+    void setIdleFlag(const std::shared_ptr<const std::atomic<bool> > &idle)
+    {
+        if (this->idle != idle)
+        {
+            this->idle = idle;
+        }
+    }
+
+    /********************************************************/
+    // True if the last read left the payload unread
+    bool isSkipped() const
+    {
+        return skipped;
+    }
+
+    /********************************************************/
+    void clear()
+    {
+        nContacts = 0;
+        nTaxels = 0;
+    }
+
+    /********************************************************/
+    size_t size() const
+    {
+        return nContacts;
+    }
+
+    /********************************************************/
+    const Contact &operator[](const size_t i) const
+    {
+        return contacts[i];
+    }
+
+    /********************************************************/
+    const int *taxels(const Contact &c) const
+    {
+        return taxelIds.data() + c.taxelsBegin;
+    }
+
+    /********************************************************/
+    // Time taken by the last read or fromBinary
+    std::chrono::steady_clock::duration getDecodeTime() const
+    {
+        return decodeTime;
+    }
+
+    /********************************************************/
+    bool fromBinary(const char *data, const size_t size)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        BufferReader in(data, size);
+        bool ok = parse(in);
+        decodeTime = std::chrono::steady_clock::now() - t0;
+        return ok;
+    }
+
+    /********************************************************/
+    bool fromBottle(const yarp::os::Bottle &event)
+    {
+        clear();
+        for (size_t j = 0; j < event.size(); j++)
+        {
+            yarp::os::Bottle *contact = event.get(j).asList();
+            if (contact == NULL)
+            {
+                continue;
+            }
+            Contact &c = addContact();
+            yarp::os::Bottle *ids = contact->get(FIELD_IDS).asList();
+            for (size_t i = 0; (ids != NULL) && (i < ids->size()) && (i < 4); i++)
+            {
+                c.ids[i] = ids->get(i).asInt();
+                c.nIds++;
+            }
+            yarp::os::Bottle *active = contact->get(FIELD_TAXELS).asList();
+            if (active != NULL)
+            {
+                reserveTaxels(active->size());
+                for (size_t i = 0; i < active->size(); i++)
+                {
+                    taxelIds[nTaxels++] = active->get(i).asInt();
+                }
+                c.taxelsCount = active->size();
+            }
+            c.pressure = contact->get(FIELD_PRESSURE).asDouble();
+        }
+        return true;
+    }
+
+    /********************************************************/
+    // Only the decoded fields are kept, the vector fields are left empty
+    void toBottle(yarp::os::Bottle &event) const
+    {
+        event.clear();
+        for (size_t j = 0; j < nContacts; j++)
+        {
+            const Contact &c = contacts[j];
+            yarp::os::Bottle &contact = event.addList();
+            yarp::os::Bottle &ids = contact.addList();
+            for (int i = 0; i < c.nIds; i++)
+            {
+                ids.addInt(c.ids[i]);
+            }
+            for (int k = FIELD_IDS + 1; k < FIELD_TAXELS; k++)
+            {
+                contact.addList();
+            }
+            yarp::os::Bottle &active = contact.addList();
+            for (size_t i = 0; i < c.taxelsCount; i++)
+            {
+                active.addInt(taxelIds[c.taxelsBegin + i]);
+            }
+            contact.addDouble(c.pressure);
+        }
+    }
+
+    /********************************************************/
+    bool read(yarp::os::ConnectionReader &connection) override
+    {
+        clear();
+        skipped = idle && *idle;
+        if (skipped)
+        {
+            decodeTime = std::chrono::steady_clock::duration(0);
+            return true;
+        }
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        bool ok;
+        if (connection.isTextMode())
+        {
+            ok = text.read(connection) && fromBottle(text);
+        }
+        else
+        {
+            ok = parse(connection) && !connection.isError();
+        }
+        decodeTime = std::chrono::steady_clock::now() - t0;
+        return ok;
+    }
+
+    /********************************************************/
+    bool write(yarp::os::ConnectionWriter &connection) const override
+    {
+        yarp::os::Bottle event;
+        toBottle(event);
+        return event.write(connection);
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_STAMPED_RING_H__
+#define __CALIB_OFFSETS_STAMPED_RING_H__
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+/********************************************************/
+// Fixed-size ring of timestamped samples, looked up by time.
+template <class T>
+class StampedRing
+{
+    struct Entry
+    {
+        double t;
+        T value;
+    };
+
+    std::vector<Entry> ring;
+    size_t head;
+    size_t count;
+    std::mutex mtx;
+
+    /********************************************************/
+    // latest sample stamped not after t and earliest one stamped after t,
+    // each discarded if farther than maxSkew from t
+    void bracket(const double t, const double maxSkew, const Entry *&before, const Entry *&after)
+    {
+        before = NULL;
+        after = NULL;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Entry &e = ring[(head + ring.size() - 1 - i) % ring.size()];
+            if (e.t <= t)
+            {
+                if ((before == NULL) || (e.t > before->t))
+                {
+                    before = &e;
+                }
+            }
+            else if ((after == NULL) || (e.t < after->t))
+            {
+                after = &e;
+            }
+        }
+
+        if ((before != NULL) && (t - before->t > maxSkew))
+        {
+            before = NULL;
+        }
+        if ((after != NULL) && (after->t - t > maxSkew))
+        {
+            after = NULL;
+        }
+    }
+
+public:
+
+    /********************************************************/
+    StampedRing() : ring(2), head(0), count(0)
+    {
+    }
+
+    /********************************************************/
+    void resize(const size_t size)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        ring.assign(std::max(size, (size_t)2), Entry());
+        head = 0;
+        count = 0;
+    }
+
+    /********************************************************/
+    void push(const double t, const T &value)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        ring[head].t = t;
+        ring[head].value = value;
+        head = (head + 1) % ring.size();
+        count = std::min(count + 1, ring.size());
+    }
+
+    /********************************************************/
+    bool nearest(const double t, const double maxSkew, T &value)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        const Entry *before, *after;
+        bracket(t, maxSkew, before, after);
+        if ((before != NULL) && ((after == NULL) || (t - before->t <= after->t - t)))
+        {
+            value = before->value;
+            return true;
+        }
+        if (after != NULL)
+        {
+            value = after->value;
+            return true;
+        }
+        return false;
+    }
+
+    /********************************************************/
+    // calls f(t, value) on every sample stamped within [t0, t1]
+    template <class F>
+    void forEach(const double t0, const double t1, F f)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        for (size_t i = 0; i < count; i++)
+        {
+            const Entry &e = ring[(head + ring.size() - 1 - i) % ring.size()];
+            if ((e.t >= t0) && (e.t <= t1))
+            {
+                f(e.t, e.value);
+            }
+        }
+    }
+
+    /********************************************************/
+    // interpolates with lerp(a, b, alpha) when t is bracketed,
+    // otherwise falls back to the nearest sample
+    template <class Lerp>
+    bool interpolate(const double t, const double maxSkew, T &value, Lerp lerp)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        const Entry *before, *after;
+        bracket(t, maxSkew, before, after);
+        if ((before != NULL) && (after != NULL))
+        {
+            value = lerp(before->value, after->value, (t - before->t) / (after->t - before->t));
+            return true;
+        }
+        if ((before != NULL) || (after != NULL))
+        {
+            value = (before != NULL) ? before->value : after->value;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_STATS_H__
+#define __CALIB_OFFSETS_STATS_H__
+
+#include <yarp/os/Bottle.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/********************************************************/
+// Latency histogram with fixed log-spaced buckets, cheap enough to be
+// updated from the skin callback for every event.
+class LatencyHistogram
+{
+public:
+    static const int nBuckets = 14;
+
+private:
+    std::atomic<long> counts[nBuckets];
+    std::atomic<long> total;
+    std::atomic<long long> sumNs;
+    std::atomic<long long> maxNs;
+
+    /********************************************************/
+    // upper bound of each bucket [us], the last one is open
+    static double edge(const int i)
+    {
+        static const double edges[nBuckets] = {1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0,
+                                               500.0, 1000.0, 2000.0, 5000.0, 10000.0, 1e12};
+        return edges[i];
+    }
+
+public:
+
+    /********************************************************/
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    /********************************************************/
+    void reset()
+    {
+        for (int i = 0; i < nBuckets; i++)
+        {
+            counts[i] = 0;
+        }
+        total = 0;
+        sumNs = 0;
+        maxNs = 0;
+    }
+
+    /********************************************************/
+    void add(const std::chrono::steady_clock::duration &d)
+    {
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        double us = 1e-3 * ns;
+        int i = 0;
+        while ((i < nBuckets - 1) && (us > edge(i)))
+        {
+            i++;
+        }
+        counts[i]++;
+        total++;
+        sumNs += ns;
+        long long m = maxNs;
+        while ((ns > m) && !maxNs.compare_exchange_weak(m, ns))
+        {
+        }
+    }
+
+    /********************************************************/
+    void toBottle(yarp::os::Bottle &b) const
+    {
+        long n = total;
+        b.addList() = yarp::os::Bottle("count " + std::to_string(n));
+        yarp::os::Bottle &mean = b.addList();
+        mean.addString("mean_us");
+        mean.addDouble((n > 0) ? 1e-3 * sumNs / n : 0.0);
+        yarp::os::Bottle &max = b.addList();
+        max.addString("max_us");
+        max.addDouble(1e-3 * maxNs);
+        yarp::os::Bottle &buckets = b.addList();
+        buckets.addString("buckets");
+        for (int i = 0; i < nBuckets; i++)
+        {
+            yarp::os::Bottle &bucket = buckets.addList();
+            if (i < nBuckets - 1)
+            {
+                bucket.addDouble(edge(i));
+            }
+            else
+            {
+                bucket.addString("inf");
+            }
+            bucket.addInt((int)counts[i]);
+        }
+    }
+};
+
+/********************************************************/
+// Counters and per-stage latencies of the skin callback.
+struct CalibStats
+{
+    enum Stage { DECODE, ROUTE, TAXELS, TRACKER, POSES, GATE, ESTIMATOR, EVENT, NSTAGES };
+
+    LatencyHistogram latency[NSTAGES];
+
+    std::atomic<long> eventsReceived;
+    std::atomic<long> droppedEvents;
+    std::atomic<long> staleEvents;
+    std::atomic<long> idleEvents;
+    std::atomic<long> contactsHandled;
+    std::atomic<long> filteredPressure;
+    std::atomic<long> filteredTaxels;
+    std::atomic<long> missedTracker;
+    std::atomic<long> rejectedLikelihood;
+    std::atomic<long> missedPoses;
+    std::atomic<long> rejectedArmMotion;
+    std::atomic<long> rejectedGazeMotion;
+    std::atomic<long> rejectedBallJitter;
+    std::atomic<long> rejectedOutliers;
+    std::atomic<long> accepted;
+
+    /********************************************************/
+    CalibStats()
+    {
+        reset();
+    }
+
+    /********************************************************/
+    void reset()
+    {
+        for (int i = 0; i < NSTAGES; i++)
+        {
+            latency[i].reset();
+        }
+        eventsReceived = 0;
+        droppedEvents = 0;
+        staleEvents = 0;
+        idleEvents = 0;
+        contactsHandled = 0;
+        filteredPressure = 0;
+        filteredTaxels = 0;
+        missedTracker = 0;
+        rejectedLikelihood = 0;
+        missedPoses = 0;
+        rejectedArmMotion = 0;
+        rejectedGazeMotion = 0;
+        rejectedBallJitter = 0;
+        rejectedOutliers = 0;
+        accepted = 0;
+    }
+
+    /********************************************************/
+    static const char *stageName(const int i)
+    {
+        static const char *names[NSTAGES] = {"decode", "route", "taxels", "tracker", "poses", "gate", "estimator", "event"};
+        return names[i];
+    }
+
+    /********************************************************/
+    yarp::os::Bottle toBottle() const
+    {
+        yarp::os::Bottle b;
+        yarp::os::Bottle &counters = b.addList();
+        counters.addString("counters");
+        counters.addList() = yarp::os::Bottle("events_received " + std::to_string(eventsReceived));
+        counters.addList() = yarp::os::Bottle("dropped_events " + std::to_string(droppedEvents));
+        counters.addList() = yarp::os::Bottle("stale_events " + std::to_string(staleEvents));
+        counters.addList() = yarp::os::Bottle("idle_events " + std::to_string(idleEvents));
+        counters.addList() = yarp::os::Bottle("contacts_handled " + std::to_string(contactsHandled));
+        counters.addList() = yarp::os::Bottle("filtered_pressure " + std::to_string(filteredPressure));
+        counters.addList() = yarp::os::Bottle("filtered_taxels " + std::to_string(filteredTaxels));
+        counters.addList() = yarp::os::Bottle("missed_tracker " + std::to_string(missedTracker));
+        counters.addList() = yarp::os::Bottle("rejected_likelihood " + std::to_string(rejectedLikelihood));
+        counters.addList() = yarp::os::Bottle("missed_poses " + std::to_string(missedPoses));
+        counters.addList() = yarp::os::Bottle("rejected_arm_motion " + std::to_string(rejectedArmMotion));
+        counters.addList() = yarp::os::Bottle("rejected_gaze_motion " + std::to_string(rejectedGazeMotion));
+        counters.addList() = yarp::os::Bottle("rejected_ball_jitter " + std::to_string(rejectedBallJitter));
+        counters.addList() = yarp::os::Bottle("rejected_outliers " + std::to_string(rejectedOutliers));
+        counters.addList() = yarp::os::Bottle("accepted " + std::to_string(accepted));
+
+        yarp::os::Bottle &latencies = b.addList();
+        latencies.addString("latency");
+        for (int i = 0; i < NSTAGES; i++)
+        {
+            yarp::os::Bottle &stage = latencies.addList();
+            stage.addString(stageName(i));
+            latency[i].toBottle(stage);
+        }
+        return b;
+    }
+};
+
+/********************************************************/
+// Measures consecutive stages of the skin callback.
+class StageTimer
+{
+    CalibStats &stats;
+    std::chrono::steady_clock::time_point t0;
+
+public:
+
+    /********************************************************/
+    StageTimer(CalibStats &stats) : stats(stats), t0(std::chrono::steady_clock::now())
+    {
+    }
+
+    /********************************************************/
+    void lap(const CalibStats::Stage stage)
+    {
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        stats.latency[stage].add(t1 - t0);
+        t0 = t1;
+    }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#!/bin/bash
+
+################################################################################
+#                                                                              #
+# Runs calibOffsets on the simulated robot and checks that lookAndCalibrate    #
+# converges to the offsets the simulation injects ([simulation] group).        #
+#                                                                              #
+# usage: simulatedCalibration.sh <calibOffsets executable> <config.ini>       #
+#                                                                              #
+################################################################################
+
+if [[ $# -lt 2 ]] ; then
+    echo "usage: $0 <calibOffsets executable> <config.ini>"
+    exit 1
+fi
+
+module=$1
+config=$2
+name=calibOffsetsSimTest
+tolerance=0.005
+
+# a private name server, so that the test never touches a running setup
+export YARP_NAMESPACE=/$name$$
+yarpserver --write --ip 127.0.0.1 --socket ${YARP_TEST_PORT:-10111} > /dev/null 2>&1 &
+server=$!
+
+function cleanup () {
+    if [[ ! -z "$pid" ]] ; then
+        echo "quit" | yarp rpc /$name/rpc > /dev/null 2>&1
+        sleep 2
+        kill $pid > /dev/null 2>&1
+    fi
+    kill $server > /dev/null 2>&1
+    rm -f "$HOME/.config/yarp/$YARP_NAMESPACE.conf" > /dev/null 2>&1
+}
+trap cleanup EXIT
+
+for i in $(seq 1 20) ; do
+    yarp detect > /dev/null 2>&1 && break
+    sleep 0.5
+done
+
+$module --from $config --name $name --simulate &
+pid=$!
+if ! timeout 30 yarp wait /$name/rpc > /dev/null 2>&1 ; then
+    echo "calibOffsets did not start"
+    exit 1
+fi
+
+# true offset of a part from the [simulation] group, e.g. offsetLeft
+function trueOffset () {
+    awk -v key="$1" '/^\[/ { sim = ($1 == "[simulation]") }
+                     sim && $1 == key { gsub(/[()]/, ""); print $2, $3, $4 }' "$config"
+}
+
+status=0
+for part in left right ; do
+    reply=$(echo "lookAndCalibrate $part 60" | yarp rpc /$name/rpc)
+    if [[ "$reply" != *"ok"* ]] ; then
+        echo "lookAndCalibrate $part failed: $reply"
+        status=1
+        continue
+    fi
+
+    estimate=$(echo "getOffset $part" | yarp rpc /$name/rpc | sed 's/Response://' | tr -d '()')
+    key=offset$(echo ${part:0:1} | tr a-z A-Z)${part:1}
+    expected=$(trueOffset $key)
+    if ! awk -v e="$estimate" -v x="$expected" -v tol=$tolerance 'BEGIN {
+            n = split(e, a, " "); split(x, b, " ");
+            if (n != 3) exit 1;
+            for (k = 1; k <= 3; k++) if ((a[k] - b[k]) > tol || (b[k] - a[k]) > tol) exit 1;
+         }' ; then
+        echo "$part offset ($estimate) is not within $tolerance m of ($expected)"
+        status=1
+    else
+        echo "$part offset ($estimate) matches ($expected)"
+    fi
+done
+
+exit $status
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_TRACKER_READER_H__
+#define __CALIB_OFFSETS_TRACKER_READER_H__
+
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+
+#include <yarp/sig/Vector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "stampedRing.h"
+#include "sessionRecorder.h"
+
+/********************************************************/
+class TrackerReader : public yarp::os::BufferedPort<yarp::os::Bottle >
+{
+    struct Sample
+    {
+        double x, y, z;
+        double likelihood;
+    };
+
+    StampedRing<Sample> samples;
+    SessionRecorder *recorder;
+
+public:
+
+    /********************************************************/
+    TrackerReader() : recorder(NULL)
+    {
+    }
+
+    /********************************************************/
+    void configure(const int bufferSize, SessionRecorder *recorder)
+    {
+        samples.resize(bufferSize);
+        this->recorder = recorder;
+    }
+
+    /********************************************************/
+    bool open(const std::string &name)
+    {
+        this->useCallback();
+        return BufferedPort<yarp::os::Bottle >::open(name);
+    }
+
+    /********************************************************/
+    void push(const double t, const double x, const double y, const double z,
+              const double likelihood)
+    {
+        Sample s;
+        s.x = x;
+        s.y = y;
+        s.z = z;
+        s.likelihood = likelihood;
+        samples.push(t, s);
+        if ((recorder != NULL) && recorder->isActive())
+        {
+            recorder->recordTracker(t, x, y, z, likelihood);
+        }
+    }
+
+    /********************************************************/
+    void onRead( yarp::os::Bottle &ballPos )
+    {
+        if (ballPos.size() < 4)
+        {
+            return;
+        }
+
+        // pf3dTracker stamps its output with the image it was computed on;
+        // fall back to the arrival time if the envelope is missing
+        yarp::os::Stamp stamp;
+        double t = yarp::os::Time::now();
+        if (getEnvelope(stamp) && stamp.isValid())
+        {
+            t = stamp.getTime();
+        }
+
+        push(t, ballPos.get(0).asDouble(), ballPos.get(1).asDouble(),
+             ballPos.get(2).asDouble(), ballPos.get(3).asDouble());
+    }
+
+    /********************************************************/
+    // Ball sample at time t, interpolated between the two samples
+    // bracketing t or taken from the nearest one; never blocks.
+    // Returns false if no sample lies within maxSkew of t.
+    bool getSample(const double t, const double maxSkew,
+                   yarp::sig::Vector &pos, double &likelihood)
+    {
+        Sample s;
+        if (!samples.interpolate(t, maxSkew, s, [](const Sample &a, const Sample &b, const double alpha)
+            {
+                Sample r;
+                r.x = a.x + alpha * (b.x - a.x);
+                r.y = a.y + alpha * (b.y - a.y);
+                r.z = a.z + alpha * (b.z - a.z);
+                r.likelihood = std::min(a.likelihood, b.likelihood);
+                return r;
+            }))
+        {
+            return false;
+        }
+
+        pos.resize(3);
+        pos[0] = s.x;
+        pos[1] = s.y;
+        pos[2] = s.z;
+        likelihood = s.likelihood;
+        return true;
+    }
+
+    /********************************************************/
+    // RMS distance of the ball samples of the window before t from their
+    // mean; false if the window holds less than two samples
+    bool getJitter(const double t, const double window, double &jitter)
+    {
+        double sum[3] = {0.0, 0.0, 0.0};
+        double sumSq = 0.0;
+        int n = 0;
+        samples.forEach(t - window, t, [&](const double, const Sample &s)
+        {
+            sum[0] += s.x;
+            sum[1] += s.y;
+            sum[2] += s.z;
+            sumSq += s.x * s.x + s.y * s.y + s.z * s.z;
+            n++;
+        });
+        if (n < 2)
+        {
+            return false;
+        }
+        double meanSq = (sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]) / (n * n);
+        jitter = std::sqrt(std::max(0.0, sumSq / n - meanSq));
+        return true;
+    }
+};
+
+#endif
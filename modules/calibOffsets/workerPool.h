@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Vadim Tikhanoff
+ * email:  vadim.tikhanoff@iit.it
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef __CALIB_OFFSETS_WORKER_POOL_H__
+#define __CALIB_OFFSETS_WORKER_POOL_H__
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/********************************************************/
+// Threads shared by the sessions of a multi-robot server. A session posts
+// the draining of its skin queue, so that the events of one robot are
+// processed in order while all the robots share the same threads.
+class WorkerPool
+{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mtx;
+    std::condition_variable available;
+    bool stopping;
+
+    /********************************************************/
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lk(mtx);
+                available.wait(lk, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+
+    /********************************************************/
+    WorkerPool(const int size) : stopping(false)
+    {
+        for (int i = 0; i < std::max(size, 1); i++)
+        {
+            workers.push_back(std::thread([this]() { work(); }));
+        }
+    }
+
+    /********************************************************/
+    ~WorkerPool()
+    {
+        stop();
+    }
+
+    /********************************************************/
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    /********************************************************/
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    /********************************************************/
+    // Runs the tasks already posted, then joins the threads
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            stopping = true;
+        }
+        available.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (workers[i].joinable())
+            {
+                workers[i].join();
+            }
+        }
+    }
+};
+
+#endif